@@ -12,6 +12,10 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// The cache holds NBUF buffers, allocated from a slab cache. When
+// all are in use, bget() allocates more rather than panic, and
+// brelse() frees unused ones again until NBUF are left.
 
 
 #include "types.h"
@@ -22,10 +26,13 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "slab.h"
+
+static struct slabcache bufcache;
 
 struct {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  int nbuf;
 
   // Linked list of all buffers, through prev/next.
   // Sorted by how recently the buffer was used.
@@ -33,23 +40,37 @@ struct {
   struct buf head;
 } bcache;
 
-void
-binit(void)
+// Allocate a buffer and put it at the LRU end of the list.
+// bcache.lock must be held, except in binit().
+static struct buf*
+bgrow(void)
 {
   struct buf *b;
 
+  if((b = slaballoc(&bufcache)) == 0)
+    return 0;
+  memset(b, 0, sizeof(*b));
+  initsleeplock(&b->lock, "buffer");
+  b->next = &bcache.head;
+  b->prev = bcache.head.prev;
+  bcache.head.prev->next = b;
+  bcache.head.prev = b;
+  bcache.nbuf++;
+  return b;
+}
+
+void
+binit(void)
+{
   initlock(&bcache.lock, "bcache");
+  slabinit(&bufcache, "buf", sizeof(struct buf));
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
   bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
+  for(int i = 0; i < NBUF; i++)
+    if(bgrow() == 0)
+      panic("binit");
 }
 
 // Look through buffer cache for block on device dev.
@@ -73,19 +94,21 @@ bget(uint dev, uint blockno)
   }
 
   // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
+  // Recycle the least recently used (LRU) unused buffer,
+  // or add one if all are in use.
   for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+    if(b->refcnt == 0)
+      break;
   }
-  panic("bget: no buffers");
+  if(b == &bcache.head && (b = bgrow()) == 0)
+    panic("bget: no buffers");
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -132,7 +155,18 @@ brelse(struct buf *b)
     bcache.head.next->prev = b;
     bcache.head.next = b;
   }
-  
+
+  // shrink back to NBUF, dropping the least recently used.
+  for(b = bcache.head.prev; bcache.nbuf > NBUF && b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0){
+      b->next->prev = b->prev;
+      b->prev->next = b->next;
+      slabfree(&bufcache, b);
+      bcache.nbuf--;
+      break;
+    }
+  }
+
   release(&bcache.lock);
 }
 
@@ -0,0 +1,15 @@
+// Per-hart scheduling statistics, returned by cpustat().
+struct cpustat {
+  int cpu;          // Hart id
+  int nrunnable;    // Processes waiting on its run queue
+  uint64 busy;      // Timer ticks spent running a process
+  uint64 idle;      // Timer ticks spent idle in the scheduler
+  uint64 nswitch;   // Processes scheduled
+  uint64 nsteal;    // Processes stolen from other harts' queues
+  uint64 nmigrate;  // Processes moved here by the load balancer
+  uint64 npreempt;  // Processes preempted by reschedule IPIs
+  uint64 npghit;    // kalloc()s served by the hart's page magazine
+  uint64 npgrefill; // Magazine refills from the global free list
+  uint64 npgdrain;  // Batches given back to the global free list
+  uint64 npgsteal;  // Steals from other harts' magazines
+};
@@ -2,14 +2,24 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct lockhold;
+struct memstat;
 struct pipe;
 struct proc;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
+struct slabcache;
 struct stat;
 struct superblock;
+struct ukdata;
 
 #define MAX_WAIT_TIME 32
+#define BALANCE_TICKS 4
+#define CFS_LATENCY   6     // ticks in which each CFS process should run
+#define CFS_WEIGHT0   1024  // CFS weight of nice 0
+#define CFS_SCALE     1024  // vruntime units per tick at CFS_WEIGHT0
 
 // bio.c
 void            binit(void);
@@ -63,10 +73,14 @@ void            ramdiskrw(struct buf*);
 
 // kalloc.c
 void            incpgrc(void *);
-void            decpgrc(int);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kmemstat(struct memstat*);
+void*           kalloc_zeroed(void);
+int             kzeroone(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -75,6 +89,7 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -111,9 +126,44 @@ int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 int             waitx(uint64, uint*, uint*);
-#if defined(PBS)
+int             do_rand(unsigned long*);
 int             set_priority(int new_priority, int pid);
-#endif
+int             compare_priority(struct proc*, struct proc*);
+int             compute_priority(int, int);
+int             setscheduler(int, int);
+int             dlthrottle(struct proc*);
+void            dlthrottlelater(struct proc*);
+int             sched_setaffinity(int, int);
+int             sched_getaffinity(int);
+extern struct ukdata *ukdata;
+
+// runq.c
+void            runqinit(void);
+void            runqadd(struct proc*, int);
+void            runqremove(struct proc*);
+void            runqstolen(struct proc*, int);
+struct proc*    runqpick(int);
+struct proc*    runqsteal(int);
+void            runqbalance(void);
+void            runqsettickets(struct proc*, int);
+void            runqsetpriority(struct proc*, int);
+void            runqsetpolicy(struct proc*, int);
+int             runqsetdeadline(struct proc*, int, int, int);
+void            runqsetaffinity(struct proc*, int);
+int             runqcpus(void);
+int             runqtick(struct proc*);
+int             runqselect(struct proc*);
+void            runqresched(int);
+int             runqpreempted(void);
+char*           schedname(int);
+extern int      schedpolicy;
+
+// timer.c
+void            timerinit(void);
+void            timertick(void);
+int             sleepuntil(uint);
+void            hrtimertick(void);
+int             hrsleepuntil(uint64);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -125,6 +175,41 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+void            lockdump(void);
+
+// lockstat.c
+extern int      lockprof;
+void            lockstart(struct lockhold*, uint64, uint64, int);
+void            lockrecord(void*, char*, int, struct lockhold*);
+void            lockstatctl(int);
+int             lockstatread(uint64, int);
+uint64          lockstatdropped(void);
+
+// rcu.c
+void            rcuinit(void);
+void            rcureadlock(void);
+void            rcureadunlock(void);
+uint64          rcurequest(void);
+int             rcudone(uint64);
+void            rcupoll(void);
+void            rcuwait(uint64);
+
+// rwlock.c
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
+void            initseqlock(struct seqlock*, char*);
+void            seqwritebegin(struct seqlock*);
+void            seqwriteend(struct seqlock*);
+uint            seqreadbegin(struct seqlock*);
+int             seqreadretry(struct seqlock*, uint);
+
+// slab.c
+void            slabinit(struct slabcache*, char*, int);
+void*           slaballoc(struct slabcache*);
+void            slabfree(struct slabcache*, void*);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -149,6 +234,16 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// start.c
+#define CLOCK_TICK    1
+#define CLOCK_ONESHOT 2
+uint64          clocknow(void);
+int             clockfired(void);
+void            clockoneshot(uint64);
+uint64          clockstop(void);
+int             clockrestart(uint64);
+void            ipi(int);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
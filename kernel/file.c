@@ -12,17 +12,19 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
-struct {
-  struct spinlock lock;
-  struct file file[NFILE];
-} ftable;
+
+// Open files come from a slab cache, so there is no limit on
+// them but memory. f->ref is changed atomically; whoever drops
+// it to 0 frees the file, and nobody else can still be using it.
+static struct slabcache filecache;
 
 void
 fileinit(void)
 {
-  initlock(&ftable.lock, "ftable");
+  slabinit(&filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -31,27 +33,20 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = slaballoc(&filecache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
 struct file*
 filedup(struct file *f)
 {
-  acquire(&ftable.lock);
   if(f->ref < 1)
     panic("filedup");
-  f->ref++;
-  release(&ftable.lock);
+  __sync_fetch_and_add(&f->ref, 1);
   return f;
 }
 
@@ -61,17 +56,12 @@ fileclose(struct file *f)
 {
   struct file ff;
 
-  acquire(&ftable.lock);
   if(f->ref < 1)
     panic("fileclose");
-  if(--f->ref > 0){
-    release(&ftable.lock);
+  if(__sync_sub_and_fetch(&f->ref, 1) > 0)
     return;
-  }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
-  release(&ftable.lock);
+  slabfree(&filecache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
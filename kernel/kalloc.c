@@ -1,66 +1,133 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or blocks of 2^n contiguous pages.
+//
+// Free memory is kept by a binary buddy allocator: a free
+// block of order n is 2^n pages aligned to its size, on the
+// free list for order n. Allocating splits a larger block in
+// halves as needed, and freeing a block merges it with its
+// buddy, the other half of the block of order n+1, for as
+// long as the buddy is free too. kmem.lock protects the lists.
+//
+// Each hart also keeps a magazine of free pages, so that most
+// kalloc()s and kfree()s take no lock but the hart's own.
+// An empty magazine takes a batch of KBATCH pages from the
+// buddy allocator, or failing that half of another hart's
+// magazine; one that grows past KMAGSIZE pages gives a batch
+// back.
+//
+// Idle harts zero free pages ahead of time into a pool of up
+// to NZERO pages, which kalloc_zeroed() takes from, as long as
+// KZEROMIN pages are left free; kalloc_order() empties the pool
+// back into the buddy lists when it finds no block. Pages are
+// only filled with junk on kalloc() and kfree() when the kernel
+// is built with POISON=1.
 
 #include "types.h"
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "proc.h"
+#include "memstat.h"
 #include "defs.h"
 
+#define MAXORDER (NORDER-1)
+
+#define KMAGSIZE 64
+#define KBATCH   32
+#define NZERO    256
+#define KZEROMIN 1024   // free pages below which idle harts stop zeroing
+
 void freerange(void *pa_start, void *pa_end);
+static void buddyfree(void *pa, int o);
+static struct run *kzerotake(void);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
 struct run {
   struct run *next;
+  struct run *prev;     // only on the buddy free lists
+};
+
+// A hart's free pages. The lock is only contended when
+// another hart steals from it.
+struct kmag {
+  struct spinlock lock;
+  struct run *list;
+  int n;
 };
 
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *free[NORDER];   // free blocks of each order
+  uint64 nfree[NORDER];
+  uint64 nsplit;
+  uint64 nmerge;
+  struct kmag mag[NCPU];
 } kmem;
 
-int pgrc[PGROUNDUP(PHYSTOP) / PGSIZE] = {0};
+// Per-page metadata, in an array carved out of the pages right
+// after the kernel by kinit(), for every page from pgbase up to
+// PHYSTOP.
+struct page {
+  int ref;              // references, changed with atomics
+  int flags;            // PG_*
+  int order;            // of the free block, if PG_FREE
+};
 
-struct spinlock rclk[PGROUNDUP(PHYSTOP)/ PGSIZE];
+#define PG_FREE 0x1     // first page of a block on a buddy free list
 
-void
-incpgrc(void * pa)
+// Zeroed free pages, but for the link in their first word.
+struct {
+  struct spinlock lock;
+  struct run *list;
+  int n;
+  uint64 nhit;
+  uint64 nmiss;
+} kzero;
+
+static struct page *pages;
+static uint64 pgbase;   // first page kalloc() manages
+static uint64 bbase;    // pgbase rounded down to a MAXORDER block
+
+static struct page*
+pa2page(void *pa)
 {
-  int index = PGROUNDDOWN((uint64) pa) / PGSIZE;
-  acquire(&rclk[index]);
-  if(pgrc[index] < 0)
-  {
-    panic("negative ref count in incpgrc\n");
-  }
-  pgrc[index]++;
-  release(&rclk[index]);
+  if((uint64)pa < pgbase || (uint64)pa >= PHYSTOP)
+    panic("pa2page");
+  return &pages[((uint64)pa - pgbase) / PGSIZE];
 }
 
+// Add a reference to the allocated page at pa, e.g. for a
+// copy-on-write mapping; kfree() drops one.
 void
-decpgrc(int index)
+incpgrc(void *pa)
 {
-  if(pgrc[index] <= 0)
-  {
-    panic("negative ref count in decpgrc\n");
-  }
-  pgrc[index]--;
+  if(__atomic_fetch_add(&pa2page(pa)->ref, 1, __ATOMIC_RELAXED) <= 0)
+    panic("incpgrc");
 }
 
 void
 kinit()
 {
+  uint64 n;
+
   initlock(&kmem.lock, "kmem");
-  kmem.freelist = 0;
-  int n = PHYSTOP / PGSIZE;
-  for(int i = 0; i<n; i++)
-  {
-    initlock(&rclk[i], "refcountlock");
-  }
-  freerange(end, (void*)PHYSTOP);
+  initlock(&kzero.lock, "kzero");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kmem.mag[i].lock, "kmag");
+
+  // n also counts the few pages pages[] itself takes up, so
+  // it has some entries to spare.
+  pages = (struct page*)PGROUNDUP((uint64)end);
+  n = (PHYSTOP - (uint64)pages) / PGSIZE;
+  pgbase = PGROUNDUP((uint64)(pages + n));
+  bbase = pgbase & ~((PGSIZE << MAXORDER) - 1);
+  memset(pages, 0, n * sizeof(struct page));
+  freerange((void*)pgbase, (void*)PHYSTOP);
 }
 
 void
@@ -68,11 +135,140 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
+  acquire(&kmem.lock);
   for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-  {
-    incpgrc(p);
-    kfree(p);
+    buddyfree(p, 0);
+  release(&kmem.lock);
+}
+
+// Put block r of order o on its free list.
+static void
+buddyadd(struct run *r, int o)
+{
+  struct page *pg = pa2page(r);
+
+  pg->flags |= PG_FREE;
+  pg->order = o;
+  r->prev = 0;
+  r->next = kmem.free[o];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[o] = r;
+  kmem.nfree[o]++;
+}
+
+// Take block r of order o off its free list.
+static void
+buddydel(struct run *r, int o)
+{
+  pa2page(r)->flags &= ~PG_FREE;
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[o] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[o]--;
+}
+
+// Allocate a block of order o, splitting a larger one if
+// needed. kmem.lock must be held.
+static struct run*
+buddyalloc(int o)
+{
+  struct run *r;
+  int i;
+
+  for(i = o; i <= MAXORDER && kmem.free[i] == 0; i++)
+    ;
+  if(i > MAXORDER)
+    return 0;
+  r = kmem.free[i];
+  buddydel(r, i);
+  // give back the upper halves.
+  while(i > o){
+    i--;
+    buddyadd((struct run*)((char*)r + (PGSIZE << i)), i);
+    kmem.nsplit++;
+  }
+  return r;
+}
+
+// Free block pa of order o, merging it with its buddies.
+// kmem.lock must be held.
+static void
+buddyfree(void *pa, int o)
+{
+  uint64 b;
+  struct page *pg;
+
+  for(; o < MAXORDER; o++){
+    b = bbase + (((uint64)pa - bbase) ^ (PGSIZE << o));
+    if(b < pgbase || b + (PGSIZE << o) > PHYSTOP)
+      break;
+    pg = pa2page((void*)b);
+    if((pg->flags & PG_FREE) == 0 || pg->order != o)
+      break;
+    buddydel((struct run*)b, o);
+    kmem.nmerge++;
+    if(b < (uint64)pa)
+      pa = (void*)b;
+  }
+  buddyadd((struct run*)pa, o);
+}
+
+// Detach the first n pages of list *l and return them.
+static struct run*
+takepages(struct run **l, int n)
+{
+  struct run *first, *r;
+
+  first = *l;
+  if(first == 0)
+    return 0;
+  for(r = first; --n > 0 && r->next; r = r->next)
+    ;
+  *l = r->next;
+  r->next = 0;
+  return first;
+}
+
+// Push list r onto *l, returning its length.
+static int
+putpages(struct run **l, struct run *r)
+{
+  struct run *last;
+  int n;
+
+  if(r == 0)
+    return 0;
+  for(n = 1, last = r; last->next; last = last->next)
+    n++;
+  last->next = *l;
+  *l = r;
+  return n;
+}
+
+// Take half the pages of another hart's magazine, for hart
+// id, whose magazine is empty and that found no free pages.
+static struct run*
+kmemsteal(int id)
+{
+  struct kmag *m;
+  struct run *r;
+
+  for(int i = 1; i < NCPU; i++){
+    m = &kmem.mag[(id + i) % NCPU];
+    if(m->n == 0)
+      continue;
+    acquire(&m->lock);
+    r = takepages(&m->list, (m->n + 1) / 2);
+    m->n -= (m->n + 1) / 2;
+    release(&m->lock);
+    if(r)
+      return r;
   }
+  return 0;
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -83,27 +279,47 @@ void
 kfree(void *pa)
 {
   struct run *r;
+  struct cpu *c;
+  struct kmag *m;
+  int old;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(((uint64)pa % PGSIZE) != 0 || (uint64)pa < pgbase || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
-  int index = PGROUNDDOWN((uint64) pa) / PGSIZE;
-  acquire(&rclk[index]);
-  decpgrc(index);
+  old = __atomic_fetch_sub(&pa2page(pa)->ref, 1, __ATOMIC_ACQ_REL);
+  if(old <= 0)
+    panic("kfree: ref");
 
-  if(pgrc[index] == 0)
+  // the last reference is gone.
+  if(old == 1)
   {
+#ifdef POISON
     // Fill with junk to catch dangling refs.
     memset(pa, 1, PGSIZE);
+#endif
 
     r = (struct run*)pa;
 
-    acquire(&kmem.lock);
-    r->next = kmem.freelist;
-    kmem.freelist = r;
-    release(&kmem.lock);
+    push_off();
+    c = mycpu();
+    m = &kmem.mag[c - cpus];
+    acquire(&m->lock);
+    r->next = m->list;
+    m->list = r;
+    if(++m->n > KMAGSIZE){
+      r = takepages(&m->list, KBATCH);
+      m->n -= KBATCH;
+      acquire(&kmem.lock);
+      for(struct run *next; r; r = next){
+        next = r->next;
+        buddyfree(r, 0);
+      }
+      release(&kmem.lock);
+      c->npgdrain++;
+    }
+    release(&m->lock);
+    pop_off();
   }
-  release(&rclk[index]);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -113,17 +329,235 @@ void *
 kalloc(void)
 {
   struct run *r;
+  struct cpu *c;
+  struct kmag *m;
+  int id;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  push_off();
+  c = mycpu();
+  id = c - cpus;
+  m = &kmem.mag[id];
+  acquire(&m->lock);
+  if(m->list){
+    c->npghit++;
+  } else {
+    r = 0;
+    acquire(&kmem.lock);
+    for(int i = 0; i < KBATCH; i++){
+      struct run *p = buddyalloc(0);
+      if(p == 0)
+        break;
+      p->next = r;
+      r = p;
+    }
+    release(&kmem.lock);
+    if(r){
+      c->npgrefill++;
+    } else {
+      // steal without holding our own lock, so that two
+      // harts stealing from each other cannot deadlock.
+      release(&m->lock);
+      if((r = kmemsteal(id)) != 0)
+        c->npgsteal++;
+      else
+        r = kzerotake();
+      acquire(&m->lock);
+    }
+    m->n += putpages(&m->list, r);
+  }
+  r = m->list;
+  if(r){
+    m->list = r->next;
+    m->n--;
+  }
+  release(&m->lock);
+  pop_off();
 
   if(r)
   {
+#ifdef POISON
     memset((char*)r, 5, PGSIZE); // fill with junk
-    incpgrc(r);
+#endif
+    __atomic_store_n(&pa2page(r)->ref, 1, __ATOMIC_RELAXED);
+  }
+  return (void*)r;
+}
+
+// Take a page from the zeroed pool, or return 0 if it is empty.
+static struct run*
+kzerotake(void)
+{
+  struct run *r;
+
+  acquire(&kzero.lock);
+  if((r = kzero.list) != 0){
+    kzero.list = r->next;
+    kzero.n--;
+    r->next = 0;
+  }
+  release(&kzero.lock);
+  return r;
+}
+
+// Give every page in the pool back to the buddy allocator,
+// so they can merge again. Returns 0 if the pool was empty.
+static int
+kzerodrain(void)
+{
+  struct run *r, *next;
+
+  acquire(&kzero.lock);
+  r = kzero.list;
+  kzero.list = 0;
+  kzero.n = 0;
+  release(&kzero.lock);
+  if(r == 0)
+    return 0;
+  acquire(&kmem.lock);
+  for(; r; r = next){
+    next = r->next;
+    buddyfree(r, 0);
+  }
+  release(&kmem.lock);
+  return 1;
+}
+
+// Free pages on the buddy lists, read without kmem.lock, so
+// only a hint.
+static uint64
+nfreepages(void)
+{
+  uint64 n = 0;
+
+  for(int i = 0; i < NORDER; i++)
+    n += __atomic_load_n(&kmem.nfree[i], __ATOMIC_RELAXED) << i;
+  return n;
+}
+
+// Zero a free page into the pool. Called by idle harts, with
+// interrupts on. Returns 0 once the pool is full or free
+// memory runs low, since pooled pages cannot merge or serve
+// kalloc_order().
+int
+kzeroone(void)
+{
+  struct run *r;
+
+  if(__atomic_load_n(&kzero.n, __ATOMIC_RELAXED) >= NZERO ||
+     nfreepages() < KZEROMIN)
+    return 0;
+  if((r = kalloc()) == 0)
+    return 0;
+  pa2page(r)->ref = 0;
+  memset(r, 0, PGSIZE);
+  acquire(&kzero.lock);
+  if(kzero.n >= NZERO){
+    release(&kzero.lock);
+    pa2page(r)->ref = 1;
+    kfree(r);
+    return 0;
+  }
+  r->next = kzero.list;
+  kzero.list = r;
+  kzero.n++;
+  release(&kzero.lock);
+  return 1;
+}
+
+// Allocate a zeroed page, from the pool if it has one.
+void *
+kalloc_zeroed(void)
+{
+  struct run *r;
+
+  if((r = kzerotake()) != 0){
+#ifdef POISON
+    // nobody may have written to it since it was zeroed.
+    for(uint64 *w = (uint64*)r; w < (uint64*)((char*)r + PGSIZE); w++)
+      if(*w != 0)
+        panic("kalloc_zeroed: dirty");
+#endif
+    __atomic_store_n(&pa2page(r)->ref, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&kzero.nhit, 1, __ATOMIC_RELAXED);
+    return (void*)r;
+  }
+  __atomic_fetch_add(&kzero.nmiss, 1, __ATOMIC_RELAXED);
+  if((r = kalloc()) != 0)
+    memset(r, 0, PGSIZE);
+  return (void*)r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Returns 0 if there is no free block that large.
+// Order 0 is the same as kalloc().
+void *
+kalloc_order(int order)
+{
+  struct run *r;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  acquire(&kmem.lock);
+  r = buddyalloc(order);
+  release(&kmem.lock);
+  if(r == 0 && kzerodrain()){
+    // the pool's pages may complete a block.
+    acquire(&kmem.lock);
+    r = buddyalloc(order);
+    release(&kmem.lock);
+  }
+  if(r){
+#ifdef POISON
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
+#endif
+    __atomic_store_n(&pa2page(r)->ref, 1, __ATOMIC_RELAXED);
   }
   return (void*)r;
 }
+
+// Free a block returned by kalloc_order(order). The first
+// page holds the block's reference count.
+void
+kfree_order(void *pa, int order)
+{
+  int old;
+
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order > MAXORDER || ((uint64)pa - bbase) % (PGSIZE << order) != 0 ||
+     (uint64)pa < pgbase || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+  old = __atomic_fetch_sub(&pa2page(pa)->ref, 1, __ATOMIC_ACQ_REL);
+  if(old <= 0)
+    panic("kfree_order: ref");
+  if(old > 1)
+    return;
+#ifdef POISON
+  memset(pa, 1, PGSIZE << order); // fill with junk
+#endif
+  acquire(&kmem.lock);
+  buddyfree(pa, order);
+  release(&kmem.lock);
+}
+
+// Fill in the free memory statistics for memstat().
+void
+kmemstat(struct memstat *ms)
+{
+  acquire(&kmem.lock);
+  for(int i = 0; i < NORDER; i++)
+    ms->nfree[i] = kmem.nfree[i];
+  ms->nsplit = kmem.nsplit;
+  ms->nmerge = kmem.nmerge;
+  release(&kmem.lock);
+  ms->nmag = 0;
+  for(int i = 0; i < NCPU; i++)
+    ms->nmag += kmem.mag[i].n;
+  ms->nzero = kzero.n;
+  ms->nzhit = kzero.nhit;
+  ms->nzmiss = kzero.nmiss;
+}
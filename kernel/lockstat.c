@@ -0,0 +1,137 @@
+// Lock profiler.
+//
+// While lockprof is set, each release of a spinlock or sleep
+// lock records how long the lock took to acquire and was held,
+// keyed by the lock's name and the return address of its
+// acquire, in a table of the releasing hart. Keying by name
+// rather than address makes all the per-process, buffer and
+// inode locks of one kind share a record, so they do not fill
+// the table; samples that find it full anyway are counted.
+// Only the releasing hart writes its
+// table, with interrupts off, so recording needs no lock of its
+// own, which it could not take inside acquire() and release()
+// anyway. lockstat() copies the tables out; user/lockstat.c
+// merges them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "lockstat.h"
+#include "defs.h"
+
+int lockprof;
+static struct lockstat lstab[NCPU][NLSREC];
+static uint64 lsdropped[NCPU];
+
+static int
+lsbucket(uint64 t)
+{
+  int b;
+
+  for(b = 0; t != 0 && b < NLSBUCKET - 1; b++)
+    t >>= 1;
+  return b;
+}
+
+// Start profiling a hold of a lock, acquired from pc after
+// waiting since t0.
+void
+lockstart(struct lockhold *h, uint64 pc, uint64 t0, int contended)
+{
+  h->pc = pc;
+  h->start = clocknow();
+  h->wait = h->start - t0;
+  h->contended = contended;
+}
+
+// Record hold h of lk, which is ending. Interrupts must be off.
+void
+lockrecord(void *lk, char *name, int sleep, struct lockhold *h)
+{
+  struct lockstat *tab = lstab[cpuid()], *ls;
+  uint64 hold = clocknow() - h->start;
+  uint64 key;
+  uint i, n;
+  char *s;
+
+  key = h->pc;
+  for(s = name; *s && s < name + sizeof(ls->name) - 1; s++)
+    key = key * 31 + *s;
+
+  // open addressing; a free record has not been acquired.
+  i = key % NLSREC;
+  for(n = 0; n < NLSREC; n++, i = (i + 1) % NLSREC){
+    ls = &tab[i];
+    if(ls->nacquire == 0){
+      safestrcpy(ls->name, name, sizeof(ls->name));
+      ls->lock = (uint64)lk;
+      ls->pc = h->pc;
+      ls->cpu = cpuid();
+      ls->sleep = sleep;
+      break;
+    }
+    if(ls->pc == h->pc && strncmp(ls->name, name, sizeof(ls->name) - 1) == 0)
+      break;
+  }
+  h->start = 0;
+  if(n == NLSREC){
+    lsdropped[cpuid()]++;  // table full
+    return;
+  }
+
+  ls->nacquire++;
+  if(h->contended)
+    ls->ncontend++;
+  ls->wait += h->wait;
+  ls->hold += hold;
+  ls->waithist[lsbucket(h->wait)]++;
+  ls->holdhist[lsbucket(hold)]++;
+}
+
+// Clear the profile and start recording, or stop.
+// A record a hart is in the middle of may survive the clear.
+void
+lockstatctl(int on)
+{
+  lockprof = 0;
+  __sync_synchronize();
+  if(on){
+    memset(lstab, 0, sizeof(lstab));
+    memset(lsdropped, 0, sizeof(lsdropped));
+    __sync_synchronize();
+    lockprof = 1;
+  }
+}
+
+// Copy up to n records to the struct lockstat array at user
+// address addr. Returns the number copied, or -1.
+int
+lockstatread(uint64 addr, int n)
+{
+  struct lockstat *ls;
+  int i;
+
+  i = 0;
+  for(ls = &lstab[0][0]; ls < &lstab[NCPU][0] && i < n; ls++){
+    if(ls->nacquire == 0)
+      continue;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(*ls), (char*)ls, sizeof(*ls)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// Samples dropped because a hart's table was full.
+uint64
+lockstatdropped(void)
+{
+  uint64 n = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    n += lsdropped[i];
+  return n;
+}
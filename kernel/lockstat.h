@@ -0,0 +1,28 @@
+// Lock profile, returned by lockstat(); see lockstat.c.
+
+#define LOCKSTAT_ON   1  // clear the profile and start recording
+#define LOCKSTAT_OFF  2  // stop recording
+#define LOCKSTAT_READ 3  // copy out the records
+#define LOCKSTAT_DROPPED 4  // count samples dropped since LOCKSTAT_ON
+
+#define NLSREC 128  // records kept by each hart
+
+// Histogram buckets, by log2 of a time in mtime units:
+// bucket 0 counts times of 0, bucket b >= 1 times in
+// [2^(b-1), 2^b), and the last bucket everything longer.
+#define NLSBUCKET 16
+
+// What one hart recorded for one lock, acquired from one place.
+struct lockstat {
+  char name[16];      // Name of the lock
+  uint64 lock;        // Address of the first lock of that name recorded
+  uint64 pc;          // Return address of acquire()/acquiresleep()
+  int cpu;            // Hart that released it
+  int sleep;          // A sleep lock?
+  uint64 nacquire;    // Acquisitions
+  uint64 ncontend;    // Acquisitions that had to wait
+  uint64 wait;        // Total time waiting, in mtime units
+  uint64 hold;        // Total time held, in mtime units
+  uint64 waithist[NLSBUCKET];
+  uint64 holdhist[NLSBUCKET];
+};
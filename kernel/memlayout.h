@@ -27,8 +27,10 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // machine software interrupt
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIME_HZ 10000000            // qemu's mtime runs at 10MHz.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -62,6 +64,13 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   UMTIME (the CLINT page holding mtime, read-only)
+//   UKDATA (struct ukdata, read-only, shared by all processes)
+//   USYSCALL (p->usyscall, read-only)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSCALL (TRAPFRAME - PGSIZE)
+#define UKDATA (USYSCALL - PGSIZE)
+#define UMTIME (UKDATA - PGSIZE)
+#define UMTIME_MTIME (UMTIME + (CLINT_MTIME & (PGSIZE-1)))
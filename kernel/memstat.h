@@ -0,0 +1,13 @@
+// Free memory statistics, returned by memstat(); see kalloc.c.
+
+#define NORDER 11  // block orders of the buddy allocator, 2^0 to 2^10 pages
+
+struct memstat {
+  uint64 nfree[NORDER];  // Free blocks of each order
+  uint64 nmag;           // Free pages in the harts' magazines
+  uint64 nsplit;         // Blocks split in half to serve smaller ones
+  uint64 nmerge;         // Blocks merged with their buddies when freed
+  uint64 nzero;          // Pages in the pool zeroed by idle harts
+  uint64 nzhit;          // kalloc_zeroed()s served from the pool
+  uint64 nzmiss;         // kalloc_zeroed()s that had to zero a page
+};
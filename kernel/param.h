@@ -1,7 +1,6 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
@@ -10,7 +9,7 @@
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
+#define NLOCKSTAT    512  // contended locks lockdump() can list
+#define NPIDHASH      64  // pid hash chains, a power of 2
 #define MAXPATH      128   // maximum file path name
-#if defined(MLFQ)
 #define NQUEUE       5     // no. of queues to use for mlfq scheduling
-#endif
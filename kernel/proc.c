@@ -3,7 +3,10 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rwlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "vdso.h"
 #include "defs.h"
 
 // from FreeBSD.
@@ -47,14 +50,27 @@ struct proc proc[NPROC];
 
 struct proc *initproc;
 
+struct ukdata *ukdata;  // mapped at UKDATA in every process
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// Writers hold pidseq while a proc[] slot gets or loses its pid,
+// so procdump() can scan the table without locking every slot,
+// and see each slot before or after such a change, never
+// half-way through it.
+struct seqlock pidseq;
+
+// Processes with a pid, hashed by it, for pidlookup(). Readers
+// walk the chains under rcureadlock() only; writers change them
+// while holding pidseq. A slot that leaves its chain keeps its
+// pidnext, so a reader standing on it can go on, and it is not
+// reused until a grace period has passed, see rcu.c.
+static struct proc *pidhash[NPIDHASH];
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
 
-int totaltickets = 0;
-
 extern char trampoline[]; // trampoline.S
 
 // helps ensure that wakeups of wait()ing
@@ -63,6 +79,24 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// Sleeping processes, hashed by wait channel, so that wakeup()
+// only looks at processes that may be sleeping on its channel.
+// A process is linked on the queue of its channel from sleep()
+// until it has woken up. Lock order: the lock passed to sleep(),
+// then the queue's lock, then p->lock.
+#define NWAITQ 64
+
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitq[NWAITQ];
+
+static struct waitq*
+chanwaitq(void *chan)
+{
+  return &waitq[((uint64)chan * 0x9E3779B97F4A7C15ULL) >> 58];
+}
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -87,10 +121,20 @@ procinit(void)
   struct proc *p;
   
   initlock(&pid_lock, "nextpid");
+  initseqlock(&pidseq, "pidseq");
   initlock(&wait_lock, "wait_lock");
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitq[i].lock, "waitq");
+  runqinit();
+  rcuinit();
+  if((ukdata = (struct ukdata*)kalloc()) == 0)
+    panic("procinit: ukdata");
+  memset(ukdata, 0, PGSIZE);
+  ukdata->clockhz = MTIME_HZ;
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
+      p->rqcpu = -1;
       p->kstack = KSTACK((int) (p - proc));
   }
 }
@@ -139,6 +183,58 @@ allocpid()
   return pid;
 }
 
+// Add p to its pid hash chain. pidseq must be held.
+static void
+pidhashadd(struct proc *p)
+{
+  struct proc **head = &pidhash[p->pid & (NPIDHASH-1)];
+
+  p->pidnext = *head;
+  // readers that find p must see its pid and pidnext.
+  __atomic_store_n(head, p, __ATOMIC_RELEASE);
+}
+
+// Unlink p from its pid hash chain. pidseq must be held.
+static void
+pidhashdel(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &pidhash[p->pid & (NPIDHASH-1)]; *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      __atomic_store_n(pp, p->pidnext, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+  panic("pidhashdel");
+}
+
+// Return the process with the given pid, with p->lock held,
+// or 0 if there is none. Takes no lock but the one returned.
+static struct proc*
+pidlookup(int pid)
+{
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  rcureadlock();
+  p = __atomic_load_n(&pidhash[pid & (NPIDHASH-1)], __ATOMIC_ACQUIRE);
+  for(; p; p = __atomic_load_n(&p->pidnext, __ATOMIC_ACQUIRE))
+    if(__atomic_load_n(&p->pid, __ATOMIC_RELAXED) == pid)
+      break;
+  if(p){
+    acquire(&p->lock);
+    // it may have exited and been freed meanwhile.
+    if(p->pid != pid){
+      release(&p->lock);
+      p = 0;
+    }
+  }
+  rcureadunlock();
+  return p;
+}
+
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
@@ -147,25 +243,38 @@ static struct proc*
 allocproc(void)
 {
   struct proc *p;
+  uint64 gp;
 
+again:
+  gp = 0;
   for(p = proc; p < &proc[NPROC]; p++) {
     acquire(&p->lock);
     if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+      // pidlookup() may still be looking at a slot freed
+      // within the current grace period.
+      if(rcudone(p->rcugp))
+        goto found;
+      if(gp == 0 || p->rcugp < gp)
+        gp = p->rcugp;
     }
+    release(&p->lock);
   }
-  return 0;
+  if(gp == 0)
+    return 0;
+  rcuwait(gp);
+  goto again;
 
 found:
+  seqwritebegin(&pidseq);
   p->pid = allocpid();
   p->state = USED;
+  pidhashadd(p);
+  seqwriteend(&pidseq);
+  p->lastcpu = -1;
   p->trace = 0;
   p->tracemask = 0;
-#if defined(FCFS)
-  p->stick = ticks; // from defs.h, set by clock_intr
-#elif defined(PBS)
+  p->policy = schedpolicy;
+  p->cpumask = (1 << NCPU) - 1;
   p->stick = ticks; // from defs.h, set by clock_intr
   p->priority = 60; // default static priority is 60
   p->tickls = 0;
@@ -173,20 +282,16 @@ found:
   p->tickslp = 0;
   p->niceness = 5;  // default niceness is 5
   p->nscheduled = 0;
-#endif
-
-#if defined(LBS)
   p->tickets = 0; // by default one ticket assigned to process
-#endif
-
-#if defined(MLFQ)
   p->queue = 0;
-  p->waittime = 0;
   p->ticksused = 0;
   p->intime = 0;
+  p->vruntime = 0;
+  p->cfsrtime = 0;
+  p->cfscpu = -1;
+  p->dlthrottled = 0;
 #if defined(TRACE_QUEUE)
       printf("[%d] started process %d\n", ticks, p->pid);
-#endif
 #endif
 
   // Allocate a trapframe page.
@@ -196,6 +301,14 @@ found:
     return 0;
   }
 
+  // Allocate the page user space reads its pid from.
+  if((p->usyscall = (struct usyscall *)kalloc_zeroed()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  p->usyscall->pid = p->pid;
+
   p->sigalarm = 0;
   p->ticksn = 0;
   p->ticksp = 0;
@@ -221,9 +334,34 @@ found:
   return p;
 }
 
+// Add p to parent's children. Caller must hold wait_lock.
+static void
+linkchild(struct proc *p, struct proc *parent)
+{
+  p->parent = parent;
+  p->sibprev = 0;
+  p->sibnext = parent->children;
+  if(p->sibnext)
+    p->sibnext->sibprev = p;
+  parent->children = p;
+}
+
+// Take p off its parent's children. Caller must hold wait_lock.
+static void
+unlinkchild(struct proc *p)
+{
+  if(p->sibprev)
+    p->sibprev->sibnext = p->sibnext;
+  else
+    p->parent->children = p->sibnext;
+  if(p->sibnext)
+    p->sibnext->sibprev = p->sibprev;
+  p->parent = 0;
+}
+
 // free a proc structure and the data hanging from it,
 // including user pages.
-// p->lock must be held.
+// p->lock must be held, and wait_lock too if p has a parent.
 static void
 freeproc(struct proc *p)
 {
@@ -233,29 +371,32 @@ freeproc(struct proc *p)
   if(p->trapcopy)
     kfree((void*)p->trapcopy);
   p->trapcopy = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
-#if defined(LBS)
   p->tickets = 0;
-#endif
   p->pagetable = 0;
   p->sz = 0;
-  p->pid = 0;
-  p->parent = 0;
+  if(p->parent)
+    unlinkchild(p);
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  seqwritebegin(&pidseq);
+  pidhashdel(p);
+  p->pid = 0;
   p->state = UNUSED;
+  p->rcugp = rcurequest();
+  seqwriteend(&pidseq);
   p->trace = 0;
   p->sigalarm = 0;
   p->ticksn = 0;
   p->ticksp = 0;
   p->tickspa = 0;
   p->handler = 0;
-#if defined(FCFS)
-  p->stick = 0;
-#elif defined(PBS)
   p->stick = 0;
   p->tickls = 0;
   p->tickslp = 0;
@@ -263,14 +404,9 @@ freeproc(struct proc *p)
   p->priority = 0;
   p->niceness = 0;
   p->nscheduled = 0;
-#endif
-
-#if defined(MLFQ)
   p->queue = 0;
-  p->waittime = 0;
   p->ticksused = 0;
   p->intime = 0;
-#endif
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -304,7 +440,29 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the read-only pages user space reads instead of
+  // making system calls, see vdso.h, below the trapframe.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0)
+    goto bad;
+  if(mappages(pagetable, UKDATA, PGSIZE,
+              (uint64)ukdata, PTE_R | PTE_U) < 0)
+    goto bad1;
+  if(mappages(pagetable, UMTIME, PGSIZE,
+              PGROUNDDOWN(CLINT_MTIME), PTE_R | PTE_U) < 0)
+    goto bad2;
+
   return pagetable;
+
+ bad2:
+  uvmunmap(pagetable, UKDATA, 1, 0);
+ bad1:
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+ bad:
+  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+  uvmfree(pagetable, 0);
+  return 0;
 }
 
 // Free a process's page table, and free the
@@ -314,6 +472,9 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+  uvmunmap(pagetable, UKDATA, 1, 0);
+  uvmunmap(pagetable, UMTIME, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -352,16 +513,11 @@ userinit(void)
   p->cwd = namei("/");
 
   p->state = RUNNABLE;
-
-#if defined(MLFQ)
   p->queue = 0;
   p->intime = ticks;
-#endif
-
-#if defined(LBS)
   p->tickets = 1;
-  totaltickets++;
-#endif
+
+  runqadd(p, cpuid());
 
   release(&p->lock);
 }
@@ -433,22 +589,19 @@ fork(void)
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  linkchild(np, p);
   release(&wait_lock);
 
   acquire(&np->lock);
   np->state = RUNNABLE;
-
-#if defined(MLFQ)
-  p->queue = 0;
-  p->intime = ticks;
-#endif
-
-#if defined(LBS)
+  // an EDF reservation is not inherited.
+  np->policy = p->policy == SCHED_EDF ? schedpolicy : p->policy;
+  np->cpumask = p->cpumask;
+  np->queue = 0;
+  np->intime = ticks;
   // child should have same no. of tickets as parent
   np->tickets = p->tickets;
-  totaltickets += np->tickets;
-#endif
+  runqadd(np, runqselect(np));
   release(&np->lock);
 
   return pid;
@@ -461,12 +614,20 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibnext){
+    pp->parent = initproc;
+    if(pp->sibnext == 0)
+      break;
   }
+  // splice the whole list in front of init's children.
+  pp->sibnext = initproc->children;
+  if(pp->sibnext)
+    pp->sibnext->sibprev = pp;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -506,6 +667,8 @@ exit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+  if(p->policy == SCHED_EDF)
+    runqsetpolicy(p, schedpolicy);
   p->etime = ticks;
 
   release(&wait_lock);
@@ -531,30 +694,28 @@ wait(uint64 addr)
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through the children looking for exited ones.
     havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
+    for(pp = p->children; pp; pp = pp->sibnext){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      havekids = 1;
+      if(pp->state == ZOMBIE){
+        // Found one.
+        pid = pp->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                                sizeof(pp->xstate)) < 0) {
           release(&pp->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        freeproc(pp);
         release(&pp->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&pp->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -568,7 +729,6 @@ wait(uint64 addr)
   }
 }
 
-#if defined(PBS)
 int compute_priority(int p, int n)
 {
   int r = p - n + 5;
@@ -590,21 +750,118 @@ int compare_priority(struct proc* best, struct proc* p)
 int set_priority(int new_priority, int pid)
 {
   struct proc* p;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if((p->state == SLEEPING || p->state == RUNNING || p->state == RUNNABLE) && p->pid == pid) {
-      p->niceness = 5;
-      int old = p->priority;
-      p->priority = new_priority;
-      release(&p->lock);
-      if(new_priority < old) yield();
+  int old = -1;
+
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  if(p->state == SLEEPING || p->state == RUNNING || p->state == RUNNABLE) {
+    old = p->priority;
+    runqsetpriority(p, new_priority);
+  }
+  release(&p->lock);
+  return old;
+}
+
+// Restrict process pid to the harts in mask, of those that
+// have started. Returns -1 if there is no such process or no
+// started hart in mask. A running process on a hart it may
+// no longer use moves off it when it next gives up the cpu.
+int
+sched_setaffinity(int pid, int mask)
+{
+  struct proc *p;
+
+  if((mask &= runqcpus()) == 0)
+    return -1;
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  runqsetaffinity(p, mask);
+  release(&p->lock);
+  if(p == myproc() && (mask & (1 << cpuid())) == 0)
+    yield();
+  return 0;
+}
+
+// Return the mask of harts process pid may run on, or -1.
+int
+sched_getaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  mask = p->cpumask & runqcpus();
+  release(&p->lock);
+  return mask;
+}
+
+// Switch process pid to the given scheduling policy and return
+// its old one. pid 0 switches the system default, used for new
+// processes, and moves every live process but the EDF ones to
+// the policy with it. A policy of -1 only queries. EDF needs
+// parameters, so it can only be entered with sched_setdeadline().
+int
+setscheduler(int pid, int policy)
+{
+  struct proc *p;
+  int old = -1;
+
+  if(policy < -1 || policy >= NSCHED || policy == SCHED_EDF)
+    return -1;
+  if(pid == 0){
+    old = schedpolicy;
+    if(policy < 0)
       return old;
-    }
+    schedpolicy = policy;
+  } else {
+    if((p = pidlookup(pid)) == 0)
+      return -1;
+    old = p->policy;
+    if(policy >= 0 && p->policy != policy)
+      runqsetpolicy(p, policy);
+    release(&p->lock);
+    return old;
+  }
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->state != UNUSED && p->policy != SCHED_EDF && p->policy != policy)
+      runqsetpolicy(p, policy);
     release(&p->lock);
   }
-  return -1;
+  return old;
+}
+
+// Called by the scheduler with nothing to run: wait for an
+// interrupt instead of spinning. c->idling asks runqadd() to
+// send an IPI when it queues work for this cpu; the queues are
+// checked again after setting it, so no work is missed. Harts
+// other than 0, which keeps time, also stop their timer until
+// they have a process to preempt.
+static void
+idle(struct cpu *c, int id)
+{
+  uint64 t0;
+
+  // put the time to use zeroing pages for kalloc_zeroed(),
+  // with interrupts on so a wakeup is not kept waiting.
+  while(c->rq.nrunnable == 0 && kzeroone())
+    ;
+
+  intr_off();
+  c->idling = 1;
+  __sync_synchronize();
+  if(c->rq.nrunnable == 0 && runqsteal(id) == 0){
+    if(id != 0){
+      t0 = clockstop();
+      wfi();
+      c->idle += clockrestart(t0);
+    } else {
+      wfi();
+    }
+  }
+  c->idling = 0;
 }
-#endif
 
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
@@ -618,151 +875,62 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
   
   c->proc = 0;
+  c->started = 1;
 
-#if defined(FCFS) || defined(PBS)
-  struct proc *best = 0;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-#if defined(FCFS)
-        if(best == 0) best = p;
-        else if(best->stick > p->stick) {
-          release(&best->lock);
-          best = p;
-        }
-#elif defined(PBS)
-        if(best == 0) best = p;
-        else if(compare_priority(best, p)) {
-          release(&best->lock);
-          best = p;
-        }
-#endif
-      }
-      if(best != p) release(&p->lock);
-    }
+    // whatever is picked now was picked with every process
+    // queued so far in view.
+    c->resched = 0;
 
-    if(best != 0) {
-      best->state = RUNNING;
-      c->proc = best;
-#if defined(PBS)
-      // acquire(&tickslock);
-      best->tickls = ticks;
-      // release(&tickslock);
-      best->nscheduled++;
-#endif
-      swtch(&c->context, &best->context);
-      c->proc = 0;
-      release(&best->lock);
-    }
-    best = 0;
-  }
-#elif defined(MLFQ)
-  for(;;) {
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-    struct proc* best = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        if(best == 0) {
-          best = p;
-          continue;
-        }
+    // no rcu read section spans a trip through here.
+    c->nqs++;
+    rcupoll();
 
-        if((best->queue == p->queue && p->intime < best->intime) || (p->queue < best->queue)) {
-          release(&best->lock);
-          best = p;
-          continue;
-        }
-      }
-      release(&p->lock);
-    }
-    if(best != 0) {
-      best->ticksused = 0;
-      best->waittime = 0;
-
-      best->state = RUNNING;
-      c->proc = best;
-      // printf("scheduling %s with pid %d now\n", best->name, best->pid);
-      swtch(&c->context, &best->context);
-      c->proc = 0;
-      release(&best->lock);
+    // runqpick() and runqsteal() only look at the run queues, so
+    // the process may have been taken by another cpu before we
+    // lock it.
+    if((p = runqpick(id)) == 0 && (p = runqsteal(id)) == 0){
+      idle(c, id);
+      continue;
     }
-    best = 0;
-  }
-#elif defined(LBS)
-  for(;;){
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-
-    static int ctickets = 0;  // to store cumulative ticket sum of runnable processes
-    int i = 0;
-    int pflag = 0;
-    int rn = (rand() % totaltickets) + 1;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // printf("rn = %d\ntotal tickets = %d\n", rn, totaltickets);
-        if(i == 0)
-        {
-          ctickets = p->tickets;
-        }
-        else
-        {
-          ctickets = p->tickets + ctickets;
-        }
-        if(ctickets >= rn && pflag == 0)
-        {
-          // printf("ctickets = %d\n", ctickets);
-          pflag = 1;
-          // Switch to chosen process.  It is the process's job
-          // to release its lock and then reacquire it
-          // before jumping back to us.
-          p->state = RUNNING;
-          totaltickets -= p->tickets;
-          c->proc = p;
-          swtch(&c->context, &p->context);
-
-          // Process is done running for now.
-          // It should have changed its p->state before coming back.
-          c->proc = 0;
-          release(&p->lock);
-          break;
-        }
-        i++;
-      }
+    acquire(&p->lock);
+    if(p->state != RUNNABLE || p->rqcpu < 0 || (p->cpumask & (1 << id)) == 0){
       release(&p->lock);
+      continue;
     }
-  }
-#else
-  for(;;){
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
+    if(p->rqcpu != id){
+      c->nsteal++;
+      runqremove(p);
+      runqstolen(p, id);
+    } else {
+      runqremove(p);
     }
+    c->nswitch++;
+
+    p->tickls = ticks;
+    p->nscheduled++;
+    p->ticksused = 0;
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;
+    p->lastcpu = id;
+    p->usyscall->cpu = id;
+    c->proc = p;
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
-#endif
 }
 
 // Switch to scheduler.  Must hold only p->lock
@@ -792,23 +960,16 @@ sched(void)
   mycpu()->intena = intena;
 }
 
-#if !defined(FCFS)
 // Give up the CPU for one scheduling round.
-// will never be called in FCFS scheduling
 void
 yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
 
-#if defined(LBS)
-    totaltickets += p->tickets;
-#endif
-
   p->state = RUNNABLE;
-#if defined(MLFQ)
   // move to next queue
-  if(p->queue != NQUEUE - 1 && p->ticksused >= (1 << p->queue)) {
+  if(p->policy == SCHED_MLFQ && p->queue != NQUEUE - 1 && p->ticksused >= (1 << p->queue)) {
 #if defined(TRACE_QUEUE)
     printf("[%d] queue for %d changed from %d to %d\n", ticks, p->pid, p->queue, p->queue + 1);
 #endif
@@ -817,16 +978,40 @@ yield(void)
 
   p->intime = ticks;
   p->ticksused = 0;
-#endif
-
-#if defined(PBS)
   p->tickrng = ticks;
-#endif
+
+  // this cpu, unless p's affinity no longer allows it.
+  runqadd(p, runqselect(p));
 
   sched();
   release(&p->lock);
 }
-#endif
+
+// Called from usertrap() on a timer tick that preempts p, and
+// before returning to user space.
+// If p is an EDF process that has used its runtime for this
+// period, sleep until the next period starts and return 1.
+int
+dlthrottle(struct proc *p)
+{
+  p->dlthrottled = 0;
+  if(p->policy != SCHED_EDF || p->dlused < p->dlruntime)
+    return 0;
+  sleepuntil(p->dlnext);
+  return 1;
+}
+
+// Called from kerneltrap() on a timer tick that preempts p.
+// p may hold sleeplocks or be inside a file system operation,
+// so an EDF process that has used its runtime only notes it
+// here, and dlthrottle() puts it to sleep on its way back to
+// user space.
+void
+dlthrottlelater(struct proc *p)
+{
+  if(p->policy == SCHED_EDF && p->dlused >= p->dlruntime)
+    p->dlthrottled = 1;
+}
 
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
@@ -859,18 +1044,26 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = chanwaitq(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // Once p is on chan's wait queue and we
+  // hold p->lock, we can be guaranteed that
+  // we won't miss any wakeup (wakeup looks
+  // at the queue and locks p->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
+  p->wqprev = 0;
+  p->wqnext = wq->head;
+  if(wq->head)
+    wq->head->wqprev = p;
+  wq->head = p;
+  release(&wq->lock);
   release(lk);
 
-#if defined(PBS)
   if(p->state == RUNNING) {
     // ticks lock is already held
     p->tickrng = ticks - p->tickls;
@@ -878,7 +1071,6 @@ sleep(void *chan, struct spinlock *lk)
     if(p->tickslp + p->tickrng == 0) p->niceness = 0;
     else p->niceness = (p->tickslp * 10) / (p->tickslp + p->tickrng);
   }
-#endif
 
   // Go to sleep.
   p->chan = chan;
@@ -888,9 +1080,18 @@ sleep(void *chan, struct spinlock *lk)
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  acquire(&wq->lock);
+  if(p->wqprev)
+    p->wqprev->wqnext = p->wqnext;
+  else
+    wq->head = p->wqnext;
+  if(p->wqnext)
+    p->wqnext->wqprev = p->wqprev;
+  release(&wq->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -899,30 +1100,31 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
+  struct waitq *wq = chanwaitq(chan);
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  // unlocked peek: a sleeper is on the queue before it
+  // releases the lock the caller changed the condition under.
+  if(wq->head == 0)
+    return;
+  acquire(&wq->lock);
+  for(p = wq->head; p; p = p->wqnext) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-#if defined(PBS)
         p->tickslp = ticks - p->tickls;
         p->tickls = ticks;
         if(p->tickslp + p->tickrng == 0) p->niceness = 0;
         else p->niceness = (p->tickslp * 10) / (p->tickslp + p->tickrng);
-#endif
         p->state = RUNNABLE;
-#if defined(MLFQ)
         p->ticksused = 0;
         p->intime = ticks;
-#endif
-#if defined(LBS)
-        totaltickets += p->tickets;
-#endif
+        runqadd(p, runqselect(p));
       }
       release(&p->lock);
     }
   }
+  release(&wq->lock);
 }
 
 // Kill the process with the given pid.
@@ -933,33 +1135,22 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-#if defined(PBS)
-        p->tickslp = ticks - p->tickls;
-        p->tickls = ticks;
-        if(p->tickslp + p->tickrng == 0) p->niceness = 0;
-        else p->niceness = (p->tickslp * 10) / (p->tickslp + p->tickrng);
-#endif
-#if defined(MLFQ)
-        p->ticksused = 0;
-        p->intime = ticks;
-#endif
-#if defined(LBS)
-        totaltickets += p->tickets;
-#endif
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = pidlookup(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+    p->tickslp = ticks - p->tickls;
+    p->tickls = ticks;
+    if(p->tickslp + p->tickrng == 0) p->niceness = 0;
+    else p->niceness = (p->tickslp * 10) / (p->tickslp + p->tickrng);
+    p->ticksused = 0;
+    p->intime = ticks;
+    runqadd(p, runqselect(p));
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -1027,26 +1218,46 @@ procdump(void)
   };
   struct proc *p;
   char *state;
+  enum procstate st;
+  int pid;
+  uint seq;
 
   printf("\n");
   for(p = proc; p < &proc[NPROC]; p++){
-    if(p->state == UNUSED)
+    do {
+      seq = seqreadbegin(&pidseq);
+      pid = p->pid;
+      st = p->state;
+    } while(seqreadretry(&pidseq, seq));
+    if(st == UNUSED)
       continue;
-    if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
-      state = states[p->state];
+    if(st >= 0 && st < NELEM(states) && states[st])
+      state = states[st];
     else
       state = "???";
-#if defined (PBS)
-    printf("%d %d %d %s %s", p->pid, p->priority, p->niceness, state, p->name);
-#elif defined (FCFS)
-    printf("%d %d %s %s", p->pid, p->stick, state, p->name);
-#elif defined (MLFQ)
-    printf("%d %d %d %d %d %s %s", p->pid, p->queue, p->intime, p->waittime, p->ticksused, state, p->name);
-#elif defined (LBS)
-    printf("%d %d %s %s", p->pid, p->tickets, state, p->name);
-#else
-    printf("%d %s %s", p->pid, state, p->name);
-#endif
+    printf("%d %s ", pid, schedname(p->policy));
+    switch(p->policy){
+    case SCHED_PBS:
+      printf("%d %d ", p->priority, p->niceness);
+      break;
+    case SCHED_FCFS:
+      printf("%d ", p->stick);
+      break;
+    case SCHED_MLFQ:
+      printf("%d %d %d %d ", p->queue, p->intime,
+             p->state == RUNNABLE ? ticks - p->intime : 0, p->ticksused);
+      break;
+    case SCHED_LBS:
+      printf("%d ", p->tickets);
+      break;
+    case SCHED_CFS:
+      printf("%d ", (int)(p->vruntime / CFS_SCALE));
+      break;
+    case SCHED_EDF:
+      printf("%d/%d %d ", p->dlused, p->dlruntime, p->dlabs);
+      break;
+    }
+    printf("%s %s", state, p->name);
     printf("\n");
   }
 }
@@ -1063,32 +1274,30 @@ waitx(uint64 addr, uint* wtime, uint* rtime)
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through the children looking for exited ones.
     havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          *rtime = np->rtime;
-          *wtime = np->etime - np->ctime - np->rtime;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
+    for(np = p->children; np; np = np->sibnext){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+
+      havekids = 1;
+      if(np->state == ZOMBIE){
+        // Found one.
+        pid = np->pid;
+        *rtime = np->rtime;
+        *wtime = np->etime - np->ctime - np->rtime;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                sizeof(np->xstate)) < 0) {
           release(&np->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        freeproc(np);
         release(&np->lock);
+        release(&wait_lock);
+        return pid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -18,12 +18,64 @@ struct context {
   uint64 s11;
 };
 
+// Run queue lists, in order of precedence: a cpu runs a
+// process from the first non-empty one.
+#define RQ_EDF       0
+#define RQ_PBS       1
+#define RQ_MLFQ      2                  // NQUEUE lists, one per level
+#define RQ_RR        (RQ_MLFQ + NQUEUE)
+#define RQ_CFS       (RQ_RR + 1)
+#define RQ_LBS       (RQ_CFS + 1)
+#define RQ_FCFS      (RQ_LBS + 1)
+#define NRQLIST      (RQ_FCFS + 1)
+
+// Binary min-heap of queued processes, see runq.c.
+struct rqheap {
+  struct proc *p[NPROC];
+  int n;
+};
+
+// Per-CPU queue of RUNNABLE processes, see runq.c.
+struct runq {
+  struct spinlock lock;
+  struct proc *head[NRQLIST]; // Queued processes, in policy order.
+  struct proc *tail[NRQLIST];
+  uint nonempty;              // Bit i set if list i is not empty.
+  int nrunnable;              // Number of queued processes.
+  int tickets;                // Sum of tickets of queued LBS processes.
+  int fenwick[NPROC+1];       // Fenwick tree of those by proc[] slot.
+  unsigned long seed;         // State of this queue's do_rand().
+  struct rqheap pbsheap;      // PBS processes by compare_priority().
+  struct rqheap cfsheap;      // CFS processes by vruntime.
+  struct rqheap edfheap;      // EDF processes by deadline.
+  int cfsweight;              // Sum of weights of queued CFS processes.
+  uint64 cfsmin;              // Smallest vruntime seen at the head.
+  int cpu;                    // Index of the cpu this queue belongs to.
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int started;                // Has this cpu entered scheduler()?
+  int idling;                 // Waiting for an interrupt in idle()?
+  int resched;                // Preempt the running process, see runqresched().
+  uint64 nqs;                 // Quiescent states passed, see rcu.c.
+  struct runq rq;             // Processes waiting to run on this cpu.
+
+  // Statistics for cpustat(), only updated by this cpu.
+  uint64 busy;                // Timer ticks spent running a process.
+  uint64 idle;                // Timer ticks spent in scheduler().
+  uint64 nswitch;             // Processes scheduled.
+  uint64 nsteal;              // Processes taken from other cpus' queues.
+  uint64 nmigrate;            // Processes moved here by runqbalance().
+  uint64 npreempt;            // Processes preempted by reschedule IPIs.
+  uint64 npghit;              // kalloc()s served by its page magazine.
+  uint64 npgrefill;           // Magazine refills from the global free list.
+  uint64 npgdrain;            // Batches given back to the global free list.
+  uint64 npgsteal;            // Steals from other harts' magazines.
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,9 +133,6 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
-
-extern int totaltickets;
-
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -94,37 +143,72 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
-#if defined(FCFS)
-  int stick;                   // tick number when the process was started
-#elif defined(PBS)
+  int lastcpu;                 // cpu this process last ran on, or -1
+  int policy;                  // scheduling policy, SCHED_* in sched.h
+  int cpumask;                 // harts p may run on, bit i for cpus[i]
+
+  // FCFS and PBS
   int stick;                   // tick number when the process was started
+
+  // PBS
   int priority;                // static priority of the process
   int tickls;                  // tick number when last scheduled or when last sleep
   int tickslp;                 // ticks spent in sleeping
   int tickrng;                 // ticks spent while running
   int niceness;                // last computed niceness of the process
   int nscheduled;              // number of times the process has been scheduled
-#endif
+  int heapidx;                 // index in the run queue's heap while queued
+
+  // CFS
+  uint64 vruntime;             // weighted run time, see runq.c
+  uint cfsrtime;               // rtime already charged to vruntime
+  int weight;                  // weight counted in the run queue while queued
+  int cfscpu;                  // cpu whose queue vruntime is measured on, or -1
+  uint64 cfsbase;              // that queue's cfsmin when p left it
 
-#if defined(MLFQ)
+  // EDF, see runqsetdeadline()
+  int dlruntime;               // ticks reserved in every period
+  int dlperiod;                // ticks in a period
+  int dldeadline;              // deadline, in ticks from the start of a period
+  int dlused;                  // ticks used in the current period
+  int dlthrottled;             // used its runtime in the kernel, throttle in usertrap()?
+  uint dlabs;                  // tick of the current period's deadline
+  uint dlnext;                 // tick the next period starts
+  uint64 dlbw;                 // reserved share of a hart
+
+  // MLFQ; the run queue's lock protects queue and intime while p is queued.
   int queue;                   // priority of the process 0 - NQUEUEs
-  int waittime;                // ticks the process spent in runnable state
   int ticksused;               // ticks used of the current time slice
-  int intime;                  // used for implementing queue
-#endif
+  int intime;                  // tick p joined its current queue level
 
-#if defined(LBS)
+  // LBS
   int tickets;                 // tickets assigned to the process
-#endif
 
-  // wait_lock must be held when using this:
+  // p->lock and the run queue's lock must be held when using these:
+  int rqcpu;                   // cpu whose run queue holds p, or -1
+  struct proc *rqnext;         // neighbours on that run queue
+  struct proc *rqprev;
+
+  // the lock of the wait queue holding p must be held when using these:
+  struct proc *wqnext;         // neighbours on the wait queue of p->chan
+  struct proc *wqprev;
+
+  // pidseq's lock must be held to change these, see pidlookup():
+  struct proc *pidnext;        // next on p's pid hash chain
+  uint64 rcugp;                // grace period to wait for before reuse
+
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // first child
+  struct proc *sibnext;        // neighbours on the parent's children list
+  struct proc *sibprev;
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // read-only page at USYSCALL
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
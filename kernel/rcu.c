@@ -0,0 +1,118 @@
+// Read-copy-update, for tables that are read without locks.
+//
+// A reader looks at the shared data between rcureadlock() and
+// rcureadunlock(). It cannot sleep or be switched away from in
+// between, since interrupts are off. A writer unlinks data under
+// a lock of its own, and may reuse it only after a grace period,
+// once every hart that could still be reading it has passed a
+// quiescent state: gone through scheduler(), come in from user
+// space, or idled. Harts count quiescent states in cpu->nqs.
+//
+// A grace period starts by taking a snapshot of every hart's
+// nqs, and completes once each other hart's has moved on.
+// Writers ask for one with rcurequest(). scheduler() and
+// clockintr() move them along with rcupoll().
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  uint64 done;             // grace periods completed
+  uint64 want;             // complete grace periods up to this one
+  int busy;                // is grace period done+1 in progress?
+  uint64 snap[NCPU];       // each hart's nqs when it started
+} rcu;
+
+void
+rcuinit(void)
+{
+  initlock(&rcu.lock, "rcu");
+}
+
+void
+rcureadlock(void)
+{
+  push_off();
+}
+
+void
+rcureadunlock(void)
+{
+  pop_off();
+}
+
+// Ask for a grace period to cover readers that may be looking at
+// data unlinked before the call. Returns the number to pass to
+// rcudone(): the current grace period, if one is in progress, may
+// have missed them, so they need the one after it.
+uint64
+rcurequest(void)
+{
+  uint64 gp;
+
+  acquire(&rcu.lock);
+  gp = rcu.done + (rcu.busy ? 2 : 1);
+  if(gp > rcu.want)
+    rcu.want = gp;
+  release(&rcu.lock);
+  return gp;
+}
+
+// Has grace period gp completed?
+int
+rcudone(uint64 gp)
+{
+  return __atomic_load_n(&rcu.done, __ATOMIC_ACQUIRE) >= gp;
+}
+
+// Complete the grace period in progress if every hart has passed
+// a quiescent state since it started, and start the next one if
+// one is wanted. Must not be called inside a read section.
+void
+rcupoll(void)
+{
+  struct cpu *c;
+
+  // nothing to do, the common case.
+  if(__atomic_load_n(&rcu.want, __ATOMIC_RELAXED) <=
+     __atomic_load_n(&rcu.done, __ATOMIC_RELAXED))
+    return;
+  acquire(&rcu.lock);
+  __sync_synchronize();
+  if(rcu.busy){
+    for(c = cpus; c < &cpus[NCPU]; c++){
+      if(c == mycpu() || !c->started || c->idling)
+        continue;
+      if(c->nqs == rcu.snap[c - cpus]){
+        release(&rcu.lock);
+        return;
+      }
+    }
+    rcu.busy = 0;
+    __atomic_store_n(&rcu.done, rcu.done + 1, __ATOMIC_RELEASE);
+  }
+  if(rcu.want > rcu.done){
+    for(c = cpus; c < &cpus[NCPU]; c++)
+      rcu.snap[c - cpus] = c->nqs;
+    rcu.busy = 1;
+  }
+  release(&rcu.lock);
+}
+
+// Wait for grace period gp to complete, letting other
+// processes run meanwhile.
+void
+rcuwait(uint64 gp)
+{
+  while(!rcudone(gp)){
+    rcupoll();
+    if(!rcudone(gp))
+      yield();
+  }
+}
@@ -265,6 +265,23 @@ r_time()
   return x;
 }
 
+// cycle counter, readable in supervisor mode
+// since start() sets mcounteren.CY.
+static inline uint64
+r_cycle()
+{
+  uint64 x;
+  asm volatile("rdcycle %0" : "=r" (x) );
+  return x;
+}
+
+// wait for an interrupt.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // enable device interrupts
 static inline void
 intr_on()
@@ -0,0 +1,1193 @@
+// Per-CPU run queues and scheduling classes.
+//
+// Each hart keeps its own queue of RUNNABLE processes in
+// cpus[i].rq, so the scheduler only has to look at its own
+// queue to decide what to run next instead of locking every
+// entry of proc[].
+//
+// A process is on a run queue exactly when it is RUNNABLE.
+// p->rqcpu names the queue holding it, or is -1.
+//
+// Harts only share work in two ways: a hart with an empty queue
+// steals from the busiest one (runqsteal), and clockintr()
+// periodically migrates a process from the busiest to the idlest
+// hart (runqbalance).
+//
+// Every scheduling policy is a struct sched_class, and each
+// process is scheduled by the class of its p->policy. A queue is
+// a set of FIFO lists, NRQLIST in all, in order of precedence
+// (see proc.h): each class owns one or more of them, plus any
+// structure of its own, and a bitmap records the non-empty lists.
+// A cpu runs the process the class of its first non-empty list
+// picks, and a running process is preempted on a timer tick when
+// its class says so or a list before its own has work. A process
+// queued on a hart running one it should preempt does not wait
+// for that tick: rqkick() sends the hart a reschedule IPI.
+//
+// Lock order: p->lock, then rq->lock. The scheduler picks a
+// candidate under rq->lock only, drops it, and then takes
+// p->lock and re-checks p->rqcpu before removing it.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sched.h"
+#include "defs.h"
+
+struct sched_class {
+  char *name;
+  int list;       // first run queue list owned by the class
+  int nlist;      // number of lists it owns
+  // rq->lock must be held for these:
+  void (*enqueue)(struct runq*, struct proc*);
+  void (*dequeue)(struct runq*, struct proc*);
+  struct proc* (*pick_next)(struct runq*);
+  // called on each timer tick with the running process;
+  // return non-zero to preempt it.
+  int (*tick)(struct proc*);
+  // should p, just queued, preempt cur, running on its hart,
+  // from the same list? only a hint: cur's lock is not held.
+  int (*preempt)(struct proc *p, struct proc *cur);
+};
+
+static struct sched_class *classes[NSCHED];
+static struct sched_class *listclass[NRQLIST];
+
+// the policy of the first process, and of every process
+// after setscheduler(0, policy).
+int schedpolicy = SCHEDULER;
+
+// Which of the queue's lists p belongs on.
+static int
+rqlist(struct proc *p)
+{
+  if(p->policy == SCHED_MLFQ)
+    return RQ_MLFQ + p->queue;
+  return classes[p->policy]->list;
+}
+
+// May p run on cpu?
+static int
+rqallowed(struct proc *p, int cpu)
+{
+  return (p->cpumask & (1 << cpu)) != 0;
+}
+
+// Insert p into list i of rq after prev, or at the head
+// if prev is 0. rq->lock must be held.
+static void
+rqinsert(struct runq *rq, int i, struct proc *prev, struct proc *p)
+{
+  p->rqprev = prev;
+  if(prev){
+    p->rqnext = prev->rqnext;
+    prev->rqnext = p;
+  } else {
+    p->rqnext = rq->head[i];
+    rq->head[i] = p;
+  }
+  if(p->rqnext)
+    p->rqnext->rqprev = p;
+  else
+    rq->tail[i] = p;
+  rq->nonempty |= 1 << i;
+}
+
+// Unlink p from list i of rq. rq->lock must be held.
+static void
+rqunlink(struct runq *rq, int i, struct proc *p)
+{
+  if(p->rqprev)
+    p->rqprev->rqnext = p->rqnext;
+  else
+    rq->head[i] = p->rqnext;
+  if(p->rqnext)
+    p->rqnext->rqprev = p->rqprev;
+  else
+    rq->tail[i] = p->rqprev;
+  p->rqnext = 0;
+  p->rqprev = 0;
+  if(rq->head[i] == 0)
+    rq->nonempty &= ~(1 << i);
+}
+
+// The first non-empty list of rq from list i on, or -1.
+static int
+rqfirst(struct runq *rq, int i)
+{
+  for(; i < NRQLIST; i++)
+    if(rq->nonempty & (1 << i))
+      return i;
+  return -1;
+}
+
+// Binary min-heap of processes, ordered by a class's before().
+// rq->lock must be held by all of these.
+
+static void
+heapset(struct rqheap *h, int i, struct proc *p)
+{
+  h->p[i] = p;
+  p->heapidx = i;
+}
+
+// Move the process at i up while it should run before its parent.
+static void
+heapsiftup(struct rqheap *h, int i, int (*before)(struct proc*, struct proc*))
+{
+  struct proc *p = h->p[i];
+
+  while(i > 0 && before(p, h->p[(i-1)/2])){
+    heapset(h, i, h->p[(i-1)/2]);
+    i = (i-1)/2;
+  }
+  heapset(h, i, p);
+}
+
+// Move the process at i down while a child should run before it.
+static void
+heapsiftdown(struct rqheap *h, int i, int (*before)(struct proc*, struct proc*))
+{
+  struct proc *p = h->p[i];
+  int c;
+
+  while((c = 2*i + 1) < h->n){
+    if(c + 1 < h->n && before(h->p[c+1], h->p[c]))
+      c++;
+    if(!before(h->p[c], p))
+      break;
+    heapset(h, i, h->p[c]);
+    i = c;
+  }
+  heapset(h, i, p);
+}
+
+static void
+heappush(struct rqheap *h, struct proc *p, int (*before)(struct proc*, struct proc*))
+{
+  heapset(h, h->n++, p);
+  heapsiftup(h, p->heapidx, before);
+}
+
+static void
+heapdel(struct rqheap *h, struct proc *p, int (*before)(struct proc*, struct proc*))
+{
+  int i = p->heapidx;
+  struct proc *last = h->p[--h->n];
+
+  p->heapidx = -1;
+  if(last == p)
+    return;
+  heapset(h, i, last);
+  heapsiftdown(h, i, before);
+  heapsiftup(h, last->heapidx, before);
+}
+
+//
+// Round robin: one FIFO list, preempted on every tick.
+//
+
+static void
+rr_enqueue(struct runq *rq, struct proc *p)
+{
+  rqinsert(rq, RQ_RR, rq->tail[RQ_RR], p);
+}
+
+static void
+rr_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_RR, p);
+}
+
+static struct proc*
+rr_pick_next(struct runq *rq)
+{
+  return rq->head[RQ_RR];
+}
+
+static int
+rr_tick(struct proc *p)
+{
+  return 1;
+}
+
+static int
+rr_preempt(struct proc *p, struct proc *cur)
+{
+  return 0;
+}
+
+static struct sched_class rr_class = {
+  "RR", RQ_RR, 1, rr_enqueue, rr_dequeue, rr_pick_next, rr_tick,
+  rr_preempt,
+};
+
+//
+// Completely fair: a min-heap by virtual runtime, the run time
+// of a process scaled by CFS_WEIGHT0 / its weight, so each
+// process gets a share of the cpu in proportion to its weight.
+// The list is only kept for runqbalance().
+//
+
+// Weight of each nice level -20..19, from Linux: every level
+// is worth about 10% of cpu time against the next one.
+static int cfsweights[40] = {
+  88761, 71755, 56483, 46273, 36291,
+  29154, 23254, 18705, 14949, 11916,
+   9548,  7620,  6100,  4904,  3906,
+   3121,  2501,  1991,  1586,  1277,
+   1024,   820,   655,   526,   423,
+    335,   272,   215,   172,   137,
+    110,    87,    70,    56,    45,
+     36,    29,    23,    18,    15,
+};
+
+// A process's weight comes from its PBS dynamic priority, so
+// set_priority and niceness apply: the default of 60 is nice
+// 0, and every 2 points up or down is one nice level.
+static int
+cfs_weight(struct proc *p)
+{
+  int nice = (compute_priority(p->priority, p->niceness) - 60) / 2;
+
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return cfsweights[nice + 20];
+}
+
+// Charge p the ticks devintr() has added to p->rtime since
+// it was last charged. Only called while p is not queued.
+static void
+cfs_charge(struct proc *p)
+{
+  uint n = p->rtime - p->cfsrtime;
+
+  p->vruntime += (uint64)n * CFS_WEIGHT0 * CFS_SCALE / cfs_weight(p);
+  p->cfsrtime = p->rtime;
+}
+
+static int
+cfs_before(struct proc *a, struct proc *b)
+{
+  return a->vruntime < b->vruntime;
+}
+
+// rq->cfsmin only moves forward, following the smallest
+// vruntime on the queue.
+static void
+cfs_updatemin(struct runq *rq)
+{
+  if(rq->cfsheap.n > 0 && rq->cfsheap.p[0]->vruntime > rq->cfsmin)
+    rq->cfsmin = rq->cfsheap.p[0]->vruntime;
+}
+
+// Each queue's vruntimes only compare with one another, and
+// its cfsmin may be far from other queues'. Move p's vruntime
+// over to rq, keeping its distance from cfsmin, as Linux does
+// on migration, so a process from a queue far ahead does not
+// wait behind every process here. Only called while p is not
+// queued.
+static void
+cfs_rebase(struct runq *rq, struct proc *p)
+{
+  long rel;
+
+  if(p->cfscpu >= 0 && p->cfscpu != rq->cpu){
+    rel = (long)(p->vruntime - p->cfsbase);
+    if(rel < 0 && (uint64)-rel > rq->cfsmin)
+      p->vruntime = 0;
+    else
+      p->vruntime = rq->cfsmin + rel;
+    p->cfsbase = rq->cfsmin;
+  }
+  p->cfscpu = rq->cpu;
+}
+
+static void
+cfs_enqueue(struct runq *rq, struct proc *p)
+{
+  uint64 floor;
+
+  cfs_charge(p);
+  cfs_rebase(rq, p);
+  // a new or woken process starts at most half a latency
+  // period behind the queue, so it can neither starve the
+  // others nor wait long behind them.
+  floor = rq->cfsmin > CFS_LATENCY * CFS_SCALE / 2 ?
+          rq->cfsmin - CFS_LATENCY * CFS_SCALE / 2 : 0;
+  if(p->vruntime < floor)
+    p->vruntime = floor;
+  rqinsert(rq, RQ_CFS, rq->tail[RQ_CFS], p);
+  heappush(&rq->cfsheap, p, cfs_before);
+  p->weight = cfs_weight(p);
+  rq->cfsweight += p->weight;
+  cfs_updatemin(rq);
+}
+
+static void
+cfs_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_CFS, p);
+  heapdel(&rq->cfsheap, p, cfs_before);
+  rq->cfsweight -= p->weight;
+  cfs_updatemin(rq);
+  // remember where p stood, in case it moves to another queue.
+  p->cfscpu = rq->cpu;
+  p->cfsbase = rq->cfsmin;
+}
+
+static struct proc*
+cfs_pick_next(struct runq *rq)
+{
+  return rq->cfsheap.n > 0 ? rq->cfsheap.p[0] : 0;
+}
+
+// Preempt p once it has had its share of CFS_LATENCY ticks,
+// in proportion to its weight, and a queued process is behind
+// it in virtual runtime. Every process on the queue so runs
+// at least once every CFS_LATENCY ticks or so.
+static int
+cfs_tick(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  int w, slice, r;
+
+  p->ticksused++;
+  cfs_charge(p);
+  w = cfs_weight(p);
+  acquire(&rq->lock);
+  slice = CFS_LATENCY * w / (rq->cfsweight + w);
+  r = p->ticksused >= slice && rq->cfsheap.n > 0 &&
+      rq->cfsheap.p[0]->vruntime < p->vruntime;
+  release(&rq->lock);
+  return r;
+}
+
+// A woken process preempts once it is more than a tick's worth
+// of virtual runtime behind, so it does not wait out cur's slice
+// but two processes do not ping-pong either.
+static int
+cfs_preempt(struct proc *p, struct proc *cur)
+{
+  return p->vruntime + CFS_SCALE < cur->vruntime;
+}
+
+static struct sched_class cfs_class = {
+  "CFS", RQ_CFS, 1, cfs_enqueue, cfs_dequeue, cfs_pick_next, cfs_tick,
+  cfs_preempt,
+};
+
+//
+// Earliest deadline first: a min-heap by absolute deadline,
+// ahead of every other class. A process reserves dlruntime
+// ticks in every dlperiod with runqsetdeadline(), which only
+// admits it if all EDF reservations fit on the started harts.
+// Once it has used its runtime, dlthrottle() in usertrap()
+// keeps it off the cpu until its next period.
+//
+
+#define DL_UNIT (1 << 20)     // bandwidth of one whole hart
+
+struct spinlock dllock;
+uint64 dlbw;                  // bandwidth reserved by EDF processes
+
+// Start a new period if the current one is over. A process
+// that sleeps through whole periods starts a fresh one when
+// it wakes, rather than catching up on the missed ones.
+static void
+edf_replenish(struct proc *p)
+{
+  if(ticks >= p->dlnext){
+    p->dlused = 0;
+    p->dlabs = ticks + p->dldeadline;
+    p->dlnext = ticks + p->dlperiod;
+  }
+}
+
+static int
+edf_before(struct proc *a, struct proc *b)
+{
+  return a->dlabs < b->dlabs;
+}
+
+static void
+edf_enqueue(struct runq *rq, struct proc *p)
+{
+  edf_replenish(p);
+  rqinsert(rq, RQ_EDF, rq->tail[RQ_EDF], p);
+  heappush(&rq->edfheap, p, edf_before);
+}
+
+static void
+edf_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_EDF, p);
+  heapdel(&rq->edfheap, p, edf_before);
+}
+
+static struct proc*
+edf_pick_next(struct runq *rq)
+{
+  return rq->edfheap.n > 0 ? rq->edfheap.p[0] : 0;
+}
+
+// Charge p this tick, and preempt it when it has used its
+// runtime or a queued process has an earlier deadline.
+static int
+edf_tick(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  int r;
+
+  edf_replenish(p);
+  p->dlused++;
+  if(p->dlused >= p->dlruntime)
+    return 1;
+  acquire(&rq->lock);
+  r = rq->edfheap.n > 0 && rq->edfheap.p[0]->dlabs < p->dlabs;
+  release(&rq->lock);
+  return r;
+}
+
+static struct sched_class edf_class = {
+  "EDF", RQ_EDF, 1, edf_enqueue, edf_dequeue, edf_pick_next, edf_tick,
+  edf_before,
+};
+
+//
+// First come first serve: a list sorted by start time,
+// never preempted by another FCFS process.
+//
+
+static void
+fcfs_enqueue(struct runq *rq, struct proc *p)
+{
+  // keep the list sorted by start time, so the head is
+  // always the oldest process. new processes are the
+  // youngest, so the walk from the tail is usually empty.
+  struct proc *prev = rq->tail[RQ_FCFS];
+  while(prev && prev->stick > p->stick)
+    prev = prev->rqprev;
+  rqinsert(rq, RQ_FCFS, prev, p);
+}
+
+static void
+fcfs_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_FCFS, p);
+}
+
+static struct proc*
+fcfs_pick_next(struct runq *rq)
+{
+  return rq->head[RQ_FCFS];
+}
+
+static int
+fcfs_tick(struct proc *p)
+{
+  return 0;
+}
+
+static struct sched_class fcfs_class = {
+  "FCFS", RQ_FCFS, 1, fcfs_enqueue, fcfs_dequeue, fcfs_pick_next, fcfs_tick,
+  rr_preempt,
+};
+
+//
+// Priority based: a min-heap ordered like compare_priority():
+// dynamic priority, then times scheduled, then newest first.
+// A process is preempted as soon as one that comes before it
+// is queued on its hart. The list is only kept for runqbalance().
+//
+
+static int
+pbs_before(struct proc *a, struct proc *b)
+{
+  return compare_priority(b, a);
+}
+
+static void
+pbs_enqueue(struct runq *rq, struct proc *p)
+{
+  rqinsert(rq, RQ_PBS, rq->tail[RQ_PBS], p);
+  heappush(&rq->pbsheap, p, pbs_before);
+}
+
+static void
+pbs_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_PBS, p);
+  heapdel(&rq->pbsheap, p, pbs_before);
+}
+
+static struct proc*
+pbs_pick_next(struct runq *rq)
+{
+  return rq->pbsheap.n > 0 ? rq->pbsheap.p[0] : 0;
+}
+
+// Normally rqkick() has already preempted p when a process that
+// comes before it was queued, but it may have missed p while
+// the hart was switching to it.
+static int
+pbs_tick(struct proc *p)
+{
+  struct runq *rq = &mycpu()->rq;
+  int r;
+
+  acquire(&rq->lock);
+  r = rq->pbsheap.n > 0 && pbs_before(rq->pbsheap.p[0], p);
+  release(&rq->lock);
+  return r;
+}
+
+static struct sched_class pbs_class = {
+  "PBS", RQ_PBS, 1, pbs_enqueue, pbs_dequeue, pbs_pick_next, pbs_tick,
+  pbs_before,
+};
+
+//
+// Lottery based: the tickets of the queued processes in a
+// Fenwick tree over proc[] slots, so a draw and an update are
+// both O(log NPROC). Preempted on every tick.
+//
+
+// Add n to the tickets p holds in rq's lottery.
+static void
+lbs_addtickets(struct runq *rq, struct proc *p, int n)
+{
+  rq->tickets += n;
+  for(int i = (p - proc) + 1; i <= NPROC; i += i & -i)
+    rq->fenwick[i] += n;
+}
+
+// Return the queued process holding ticket rn,
+// 1 <= rn <= rq->tickets.
+static struct proc*
+lbs_draw(struct runq *rq, int rn)
+{
+  int pos, step;
+
+  for(step = 1; step * 2 <= NPROC; step *= 2)
+    ;
+  // find the largest pos whose prefix sum is below rn;
+  // slot pos (1-based pos + 1) then holds ticket rn.
+  pos = 0;
+  for(; step > 0; step /= 2){
+    if(pos + step <= NPROC && rq->fenwick[pos + step] < rn){
+      pos += step;
+      rn -= rq->fenwick[pos];
+    }
+  }
+  return &proc[pos];
+}
+
+static void
+lbs_enqueue(struct runq *rq, struct proc *p)
+{
+  rqinsert(rq, RQ_LBS, rq->tail[RQ_LBS], p);
+  lbs_addtickets(rq, p, p->tickets);
+}
+
+static void
+lbs_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_LBS, p);
+  lbs_addtickets(rq, p, -p->tickets);
+}
+
+static struct proc*
+lbs_pick_next(struct runq *rq)
+{
+  // processes without tickets only run when nobody has any.
+  if(rq->tickets > 0)
+    return lbs_draw(rq, (do_rand(&rq->seed) % rq->tickets) + 1);
+  return rq->head[RQ_LBS];
+}
+
+static struct sched_class lbs_class = {
+  "LBS", RQ_LBS, 1, lbs_enqueue, lbs_dequeue, lbs_pick_next, rr_tick,
+  rr_preempt,
+};
+
+//
+// Multi-level feedback queue: one FIFO list per level. A process
+// at level i is preempted after 1 << i ticks, or as soon as a
+// higher level has work, which runqtick() checks for every class.
+//
+
+static void
+mlfq_enqueue(struct runq *rq, struct proc *p)
+{
+  // keep each level sorted by intime for mlfq_age(). p normally
+  // has just been given intime = ticks; only a migrated process
+  // has to walk back.
+  struct proc *prev = rq->tail[RQ_MLFQ + p->queue];
+  while(prev && prev->intime > p->intime)
+    prev = prev->rqprev;
+  rqinsert(rq, RQ_MLFQ + p->queue, prev, p);
+}
+
+static void
+mlfq_dequeue(struct runq *rq, struct proc *p)
+{
+  rqunlink(rq, RQ_MLFQ + p->queue, p);
+}
+
+// Move processes that have waited MAX_WAIT_TIME ticks on their
+// level to the end of the next higher one. Each level is in
+// order of intime, so only the heads that are due have to be
+// looked at. Done whenever a cpu picks from rq, and on every
+// timer tick by runqtick(), so that a process aged past the
+// running one preempts it.
+static void
+mlfq_age(struct runq *rq)
+{
+  struct proc *p;
+
+  for(int i = 1; i < NQUEUE; i++){
+    while((p = rq->head[RQ_MLFQ + i]) != 0 && ticks - p->intime >= MAX_WAIT_TIME){
+#if defined(TRACE_QUEUE)
+      printf("[%d] queue for %d changed from %d to %d\n", ticks, p->pid, i, i - 1);
+#endif
+      rqunlink(rq, RQ_MLFQ + i, p);
+      p->queue = i - 1;
+      p->intime = ticks;
+      rqinsert(rq, RQ_MLFQ + i - 1, rq->tail[RQ_MLFQ + i - 1], p);
+    }
+  }
+}
+
+static struct proc*
+mlfq_pick_next(struct runq *rq)
+{
+  int i;
+
+  mlfq_age(rq);
+  i = rqfirst(rq, RQ_MLFQ);
+
+  if(i < 0 || i >= RQ_MLFQ + NQUEUE)
+    return 0;
+  return rq->head[i];
+}
+
+static int
+mlfq_tick(struct proc *p)
+{
+  p->ticksused++;
+  return p->ticksused >= (1 << p->queue);
+}
+
+static struct sched_class mlfq_class = {
+  "MLFQ", RQ_MLFQ, NQUEUE, mlfq_enqueue, mlfq_dequeue, mlfq_pick_next, mlfq_tick,
+  rr_preempt,
+};
+
+void
+runqinit(void)
+{
+  struct cpu *c;
+  struct sched_class *sc;
+
+  classes[SCHED_RR] = &rr_class;
+  classes[SCHED_FCFS] = &fcfs_class;
+  classes[SCHED_PBS] = &pbs_class;
+  classes[SCHED_LBS] = &lbs_class;
+  classes[SCHED_MLFQ] = &mlfq_class;
+  classes[SCHED_CFS] = &cfs_class;
+  classes[SCHED_EDF] = &edf_class;
+  initlock(&dllock, "dl");
+  for(int i = 0; i < NSCHED; i++){
+    sc = classes[i];
+    for(int l = sc->list; l < sc->list + sc->nlist; l++)
+      listclass[l] = sc;
+  }
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    initlock(&c->rq.lock, "runq");
+    for(int i = 0; i < NRQLIST; i++){
+      c->rq.head[i] = 0;
+      c->rq.tail[i] = 0;
+    }
+    c->rq.nonempty = 0;
+    c->rq.nrunnable = 0;
+    c->rq.tickets = 0;
+    for(int i = 0; i <= NPROC; i++)
+      c->rq.fenwick[i] = 0;
+    c->rq.seed = c - cpus + 1;
+    c->rq.pbsheap.n = 0;
+    c->rq.cfsheap.n = 0;
+    c->rq.cfsweight = 0;
+    c->rq.cfsmin = 0;
+    c->rq.cpu = c - cpus;
+    c->rq.edfheap.n = 0;
+  }
+}
+
+// Name of a scheduling policy, for procdump().
+char*
+schedname(int policy)
+{
+  if(policy < 0 || policy >= NSCHED)
+    return "???";
+  return classes[policy]->name;
+}
+
+// Should p, just queued, preempt cur, running on its hart?
+// Yes if p is on a list before cur's, or on the same list and
+// its class says so.
+static int
+rqpreempts(struct proc *cur, struct proc *p)
+{
+  int l = rqlist(p), lcur = rqlist(cur);
+
+  return l < lcur || (l == lcur && listclass[l]->preempt(p, cur));
+}
+
+// Ask cpu to give up the process it is running as soon as it
+// can: the IPI makes it trap, and the trap handler then sees
+// runqpreempted(). The flag stays set until scheduler() next
+// picks, so an IPI taken too early is not lost.
+void
+runqresched(int cpu)
+{
+  cpus[cpu].resched = 1;
+  ipi(cpu);
+}
+
+// Should the process running here give up the cpu for one
+// queued since it was picked? Interrupts must be off.
+int
+runqpreempted(void)
+{
+  struct cpu *c = mycpu();
+
+  if(!c->resched)
+    return 0;
+  c->npreempt++;
+  return 1;
+}
+
+// Make sure a hart soon looks at p, just queued on cpu: wake
+// cpu if it is idle, preempt its process if p should run first,
+// or else wake an idle hart that may steal p. Not when p
+// requeued itself, since its cpu picks right away.
+static void
+rqkick(struct proc *p, int cpu)
+{
+  struct cpu *c;
+  struct proc *cur;
+
+  if(cpus[cpu].idling){
+    ipi(cpu);
+    return;
+  }
+  if(p == myproc())
+    return;
+  // cpus[cpu].proc may change under us; a missed preemption
+  // waits for the next tick, a needless one costs a yield().
+  cur = cpus[cpu].proc;
+  if(cur != 0 && rqpreempts(cur, p)){
+    runqresched(cpu);
+    return;
+  }
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->started && c->idling && rqallowed(p, c - cpus)){
+      ipi(c - cpus);
+      return;
+    }
+  }
+}
+
+// Put a RUNNABLE process on the run queue of the given cpu,
+// waking an idle hart to run it. p->lock must be held.
+void
+runqadd(struct proc *p, int cpu)
+{
+  struct runq *rq = &cpus[cpu].rq;
+
+  if(!holding(&p->lock))
+    panic("runqadd lock");
+  if(p->state != RUNNABLE)
+    panic("runqadd state");
+  if(p->rqcpu >= 0)
+    panic("runqadd queued");
+
+  acquire(&rq->lock);
+  classes[p->policy]->enqueue(rq, p);
+  rq->nrunnable++;
+  p->rqcpu = cpu;
+  release(&rq->lock);
+  rqkick(p, cpu);
+}
+
+// Take p off whichever run queue holds it.
+// p->lock must be held.
+void
+runqremove(struct proc *p)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqremove lock");
+  if(p->rqcpu < 0)
+    panic("runqremove");
+
+  rq = &cpus[p->rqcpu].rq;
+  acquire(&rq->lock);
+  classes[p->policy]->dequeue(rq, p);
+  rq->nrunnable--;
+  p->rqcpu = -1;
+  release(&rq->lock);
+}
+
+// Choose the process to run next from rq: the pick of the
+// class owning the first non-empty list. rq->lock must be held.
+static struct proc*
+rqbest(struct runq *rq)
+{
+  int i;
+
+  if((i = rqfirst(rq, 0)) < 0)
+    return 0;
+  return listclass[i]->pick_next(rq);
+}
+
+// rqbest() for another cpu: the process from rq that cpu may
+// run, preferring the one rq's own cpu would run next.
+// rq->lock must be held.
+static struct proc*
+rqbestfor(struct runq *rq, int cpu)
+{
+  struct proc *p;
+
+  if((p = rqbest(rq)) == 0 || rqallowed(p, cpu))
+    return p;
+  for(int i = rqfirst(rq, 0); i >= 0; i = rqfirst(rq, i + 1))
+    for(p = rq->head[i]; p; p = p->rqnext)
+      if(rqallowed(p, cpu))
+        return p;
+  return 0;
+}
+
+// Return the process cpu should run next from its own queue,
+// without locking it or taking it off the queue; the caller
+// must lock it and check that it is still queued.
+struct proc*
+runqpick(int cpu)
+{
+  struct runq *rq = &cpus[cpu].rq;
+  struct proc *p;
+
+  // unlocked peek, so an idle hart does not keep taking its lock.
+  if(rq->nrunnable == 0)
+    return 0;
+  acquire(&rq->lock);
+  p = rqbest(rq);
+  release(&rq->lock);
+  return p;
+}
+
+// Number of processes running or waiting to run on c.
+static int
+rqload(struct cpu *c)
+{
+  return c->rq.nrunnable + (c->proc != 0);
+}
+
+// Called by an idle cpu with nothing queued: return the process
+// the busiest other hart would run next, to be taken the same
+// way as runqpick()'s result.
+struct proc*
+runqsteal(int cpu)
+{
+  struct cpu *c, *busiest;
+  struct proc *p;
+
+  busiest = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c == &cpus[cpu] || !c->started || c->rq.nrunnable == 0)
+      continue;
+    if(busiest == 0 || rqload(c) > rqload(busiest))
+      busiest = c;
+  }
+  if(busiest == 0)
+    return 0;
+
+  acquire(&busiest->rq.lock);
+  p = rqbestfor(&busiest->rq, cpu);
+  release(&busiest->rq.lock);
+  return p;
+}
+
+// Move a process from the busiest to the least loaded hart
+// when their loads differ by more than one. Takes the last
+// process on the busy queue that may run on the idle hart,
+// the one least likely to still have warm caches there.
+// Called every BALANCE_TICKS from clockintr().
+void
+runqbalance(void)
+{
+  struct cpu *c, *busiest, *idlest;
+  struct proc *p;
+
+  busiest = idlest = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started)
+      continue;
+    if(busiest == 0 || rqload(c) > rqload(busiest))
+      busiest = c;
+    if(idlest == 0 || rqload(c) < rqload(idlest))
+      idlest = c;
+  }
+  if(busiest == 0 || rqload(busiest) - rqload(idlest) < 2)
+    return;
+
+  acquire(&busiest->rq.lock);
+  p = 0;
+  for(int i = NRQLIST - 1; i >= 0 && p == 0; i--)
+    for(p = busiest->rq.tail[i]; p && !rqallowed(p, idlest - cpus); p = p->rqprev)
+      ;
+  release(&busiest->rq.lock);
+  if(p == 0)
+    return;
+
+  acquire(&p->lock);
+  if(p->state == RUNNABLE && p->rqcpu == busiest - cpus){
+    runqremove(p);
+    runqadd(p, idlest - cpus);
+    idlest->nmigrate++;
+  }
+  release(&p->lock);
+}
+
+// Pick the cpu whose run queue a newly RUNNABLE process should
+// join: the hart it last ran on, to keep its cache warm, or
+// the least loaded started hart it may run on if it has not
+// run yet or may no longer run there.
+int
+runqselect(struct proc *p)
+{
+  struct cpu *c, *best;
+
+  if(p->lastcpu >= 0 && cpus[p->lastcpu].started && rqallowed(p, p->lastcpu))
+    return p->lastcpu;
+
+  best = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started || !rqallowed(p, c - cpus))
+      continue;
+    if(best == 0 || c->rq.nrunnable < best->rq.nrunnable)
+      best = c;
+  }
+  if(best == 0)
+    return 0;
+  return best - cpus;
+}
+
+// cpu has taken p from another cpu's queue to run it: measure
+// p's CFS vruntime on cpu's queue from now on. p->lock must be
+// held.
+void
+runqstolen(struct proc *p, int cpu)
+{
+  struct runq *rq = &cpus[cpu].rq;
+
+  if(p->policy != SCHED_CFS)
+    return;
+  acquire(&rq->lock);
+  cfs_rebase(rq, p);
+  release(&rq->lock);
+}
+
+// MLFQ levels that can age, all but the highest.
+#define RQ_MLFQAGE (((1 << (NQUEUE - 1)) - 1) << (RQ_MLFQ + 1))
+
+// Should the running process p give up the cpu on this timer
+// tick? Ages this cpu's MLFQ levels, asks p's class, and
+// otherwise checks the bitmap for work on a list of higher
+// precedence than p's own.
+int
+runqtick(struct proc *p)
+{
+  struct runq *rq;
+  int r;
+
+  push_off();
+  rq = &mycpu()->rq;
+  if(rq->nonempty & RQ_MLFQAGE){
+    acquire(&rq->lock);
+    mlfq_age(rq);
+    release(&rq->lock);
+  }
+  r = classes[p->policy]->tick(p) ||
+      (rq->nonempty & ((1 << rqlist(p)) - 1)) != 0;
+  pop_off();
+  return r;
+}
+
+// Move p to another scheduling policy, requeueing it if it
+// is queued. p->lock must be held.
+void
+runqsetpolicy(struct proc *p, int policy)
+{
+  int cpu = p->rqcpu;
+
+  if(!holding(&p->lock))
+    panic("runqsetpolicy");
+  if(cpu >= 0)
+    runqremove(p);
+  if(p->policy == SCHED_EDF && policy != SCHED_EDF){
+    // give back its reservation.
+    acquire(&dllock);
+    dlbw -= p->dlbw;
+    release(&dllock);
+    p->dlbw = 0;
+  }
+  if(policy == SCHED_MLFQ && p->policy != SCHED_MLFQ){
+    // start at the top level, like a new process.
+    p->queue = 0;
+    p->ticksused = 0;
+    p->intime = ticks;
+  }
+  if(policy == SCHED_CFS && p->policy != SCHED_CFS){
+    // don't charge the time run under the old policy;
+    // cfs_enqueue() moves it up to the queue.
+    p->vruntime = 0;
+    p->cfsrtime = p->rtime;
+    p->cfscpu = -1;
+  }
+  p->policy = policy;
+  if(cpu >= 0)
+    runqadd(p, cpu);
+}
+
+// Make p an EDF process that runs for runtime ticks in every
+// period, within deadline ticks of the start of the period.
+// Returns -1 if the parameters make no sense, or if the EDF
+// processes would then need more than all started harts.
+// p->lock must be held.
+int
+runqsetdeadline(struct proc *p, int runtime, int period, int deadline)
+{
+  struct cpu *c;
+  uint64 bw, old;
+  int ncpu, cpu;
+
+  if(!holding(&p->lock))
+    panic("runqsetdeadline");
+  if(runtime <= 0 || runtime > deadline || deadline > period)
+    return -1;
+
+  ncpu = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->started)
+      ncpu++;
+  bw = (uint64)runtime * DL_UNIT / period;
+  old = p->policy == SCHED_EDF ? p->dlbw : 0;
+  acquire(&dllock);
+  if(dlbw - old + bw > (uint64)ncpu * DL_UNIT){
+    release(&dllock);
+    return -1;
+  }
+  dlbw = dlbw - old + bw;
+  release(&dllock);
+
+  // the heap is ordered by deadline, so requeue p.
+  cpu = p->rqcpu;
+  if(cpu >= 0)
+    runqremove(p);
+  p->policy = SCHED_EDF;
+  p->dlbw = bw;
+  p->dlruntime = runtime;
+  p->dlperiod = period;
+  p->dldeadline = deadline;
+  p->dlused = 0;
+  p->dlabs = ticks + deadline;
+  p->dlnext = ticks + period;
+  if(cpu >= 0)
+    runqadd(p, cpu);
+  return 0;
+}
+
+// Mask of the harts that have started scheduling.
+int
+runqcpus(void)
+{
+  int mask = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    if(cpus[i].started)
+      mask |= 1 << i;
+  return mask;
+}
+
+// Restrict p to the harts in mask, moving it to one of them if
+// it is queued elsewhere. A running p moves when it next
+// yields. p->lock must be held.
+void
+runqsetaffinity(struct proc *p, int mask)
+{
+  if(!holding(&p->lock))
+    panic("runqsetaffinity");
+  p->cpumask = mask;
+  if(p->rqcpu >= 0 && !rqallowed(p, p->rqcpu)){
+    runqremove(p);
+    runqadd(p, runqselect(p));
+  }
+}
+
+// Give p n tickets, updating the lottery of the queue p is on,
+// if any, in place. p->lock must be held.
+void
+runqsettickets(struct proc *p, int n)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqsettickets");
+  if(p->rqcpu >= 0 && p->policy == SCHED_LBS){
+    rq = &cpus[p->rqcpu].rq;
+    acquire(&rq->lock);
+    lbs_addtickets(rq, p, n - p->tickets);
+    p->tickets = n;
+    release(&rq->lock);
+  } else {
+    p->tickets = n;
+  }
+}
+
+// Set p's static priority and reset its niceness, moving it
+// within the heap of the queue it is on, if any.
+// p->lock must be held.
+void
+runqsetpriority(struct proc *p, int priority)
+{
+  struct runq *rq;
+
+  if(!holding(&p->lock))
+    panic("runqsetpriority");
+  if(p->rqcpu >= 0 && p->policy == SCHED_PBS){
+    rq = &cpus[p->rqcpu].rq;
+    acquire(&rq->lock);
+    p->priority = priority;
+    p->niceness = 5;
+    heapsiftdown(&rq->pbsheap, p->heapidx, pbs_before);
+    heapsiftup(&rq->pbsheap, p->heapidx, pbs_before);
+    release(&rq->lock);
+    rqkick(p, p->rqcpu);
+  } else {
+    p->priority = priority;
+    p->niceness = 5;
+    // a running process may now come after one queued on its
+    // hart; let the hart pick again.
+    if(p->state == RUNNING && p->policy == SCHED_PBS)
+      runqresched(p->lastcpu);
+  }
+}
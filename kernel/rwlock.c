@@ -0,0 +1,112 @@
+// Reader-writer spin locks and sequence locks.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+void
+initrwlock(struct rwlock *rw, char *name)
+{
+  rw->name = name;
+  rw->count = 0;
+  rw->wwait = 0;
+}
+
+// Acquire rw shared with other readers.
+void
+acquireread(struct rwlock *rw)
+{
+  int n;
+
+  push_off(); // disable interrupts to avoid deadlock.
+  for(;;){
+    while(__atomic_load_n(&rw->wwait, __ATOMIC_RELAXED) != 0)
+      ;
+    n = __atomic_load_n(&rw->count, __ATOMIC_RELAXED);
+    if(n >= 0 && __sync_bool_compare_and_swap(&rw->count, n, n + 1))
+      break;
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwlock *rw)
+{
+  __sync_synchronize();
+  if(__sync_fetch_and_sub(&rw->count, 1) <= 0)
+    panic("releaseread");
+  pop_off();
+}
+
+// Acquire rw exclusively.
+void
+acquirewrite(struct rwlock *rw)
+{
+  push_off();
+  __sync_fetch_and_add(&rw->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&rw->count, 0, -1))
+    ;
+  __sync_fetch_and_sub(&rw->wwait, 1);
+  __sync_synchronize();
+}
+
+void
+releasewrite(struct rwlock *rw)
+{
+  if(rw->count != -1)
+    panic("releasewrite");
+  __sync_synchronize();
+  __atomic_store_n(&rw->count, 0, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+void
+initseqlock(struct seqlock *sl, char *name)
+{
+  initlock(&sl->lk, name);
+  sl->seq = 0;
+}
+
+// Start changing the data sl protects.
+void
+seqwritebegin(struct seqlock *sl)
+{
+  acquire(&sl->lk);
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+  __sync_synchronize();
+}
+
+void
+seqwriteend(struct seqlock *sl)
+{
+  __sync_synchronize();
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+  release(&sl->lk);
+}
+
+// Start reading the data sl protects. Returns the sequence
+// number to give seqreadretry() once done.
+uint
+seqreadbegin(struct seqlock *sl)
+{
+  uint seq;
+
+  while((seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED)) & 1)
+    ;
+  __sync_synchronize();
+  return seq;
+}
+
+// Must what was read since seqreadbegin() returned seq be
+// read again, since a writer changed it meanwhile?
+int
+seqreadretry(struct seqlock *sl, uint seq)
+{
+  __sync_synchronize();
+  return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
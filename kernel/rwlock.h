@@ -0,0 +1,19 @@
+// Reader-writer spin lock, for tables that are mostly looked up.
+// Any number of readers or one writer may hold it. Readers wait
+// while a writer waits, so a stream of readers cannot starve
+// writers. Not recursive: a reader that acquires it again while
+// a writer waits deadlocks.
+struct rwlock {
+  int count;         // Readers holding the lock, or -1 for a writer.
+  int wwait;         // Writers waiting.
+  char *name;        // Name of lock.
+};
+
+// Sequence lock, for data that readers copy out without
+// locking and writers rarely change. A writer makes seq odd
+// while it writes; a reader retries if seq was odd or has
+// changed meanwhile.
+struct seqlock {
+  uint seq;
+  struct spinlock lk; // Serializes writers.
+};
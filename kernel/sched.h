@@ -0,0 +1,9 @@
+// Scheduling policies, for setscheduler().
+#define SCHED_RR      0   // round robin
+#define SCHED_FCFS    1   // first come first serve
+#define SCHED_PBS     2   // priority based
+#define SCHED_LBS     3   // lottery based
+#define SCHED_MLFQ    4   // multi-level feedback queue
+#define SCHED_CFS     5   // completely fair
+#define SCHED_EDF     6   // earliest deadline first, see sched_setdeadline()
+#define NSCHED        7
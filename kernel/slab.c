@@ -0,0 +1,186 @@
+// Object caches, for kernel structures that are allocated and
+// freed often and are smaller than a page.
+//
+// A cache carves blocks from kalloc_order(), its slabs, into
+// objects of one size. A slab starts with a struct slab that
+// links its free objects through their first word; as a slab
+// is aligned to its size, the slab of an object is found by
+// rounding its address down.
+//
+// Each hart keeps up to SLABCPU free objects of every cache,
+// used with interrupts off and no lock, and moves SLABBATCH at
+// a time from or to the slabs under the cache's lock when it
+// has none left or too many.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "slab.h"
+#include "defs.h"
+
+#define SLABMAXORDER 3
+
+struct slab {
+  struct slab *next;     // neighbours on the partial list
+  struct slab *prev;
+  void *free;            // free objects
+  int nfree;
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+// Set up cache c for objects of size bytes. Picks the smallest
+// slab that wastes no more than an eighth of itself.
+void
+slabinit(struct slabcache *c, char *name, int size)
+{
+  int bytes;
+
+  initlock(&c->lock, "slab");
+  c->name = name;
+  c->size = (size + 7) & ~7;
+  for(c->order = 0; ; c->order++){
+    bytes = (PGSIZE << c->order) - SLABHDR;
+    c->nperslab = bytes / c->size;
+    if(c->nperslab > 0 && bytes - c->nperslab * c->size <= (PGSIZE << c->order) / 8)
+      break;
+    if(c->order == SLABMAXORDER){
+      if(c->nperslab == 0)
+        panic("slabinit: too big");
+      break;
+    }
+  }
+  c->partial = 0;
+  c->empty = 0;
+  c->nslab = 0;
+  for(int i = 0; i < NCPU; i++)
+    c->cpu[i].n = 0;
+}
+
+static void
+partialadd(struct slabcache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+partialdel(struct slabcache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Allocate and carve up a new slab.
+static struct slab*
+slabgrow(struct slabcache *c)
+{
+  struct slab *s;
+  char *obj;
+
+  if((s = kalloc_order(c->order)) == 0)
+    return 0;
+  s->free = 0;
+  for(int i = c->nperslab - 1; i >= 0; i--){
+    obj = (char*)s + SLABHDR + i * c->size;
+    *(void**)obj = s->free;
+    s->free = obj;
+  }
+  s->nfree = c->nperslab;
+  c->nslab++;
+  return s;
+}
+
+// Take an object from the slabs. c->lock must be held.
+static void*
+slabget(struct slabcache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  if((s = c->partial) == 0){
+    if((s = c->empty) != 0)
+      c->empty = 0;
+    else if((s = slabgrow(c)) == 0)
+      return 0;
+    partialadd(c, s);
+  }
+  obj = s->free;
+  s->free = *(void**)obj;
+  if(--s->nfree == 0)
+    partialdel(c, s);
+  return obj;
+}
+
+// Give an object back to its slab. c->lock must be held.
+static void
+slabput(struct slabcache *c, void *obj)
+{
+  struct slab *s;
+
+  s = (struct slab*)((uint64)obj & ~((PGSIZE << c->order) - 1));
+  *(void**)obj = s->free;
+  s->free = obj;
+  if(++s->nfree == 1)
+    partialadd(c, s);
+  if(s->nfree == c->nperslab){
+    partialdel(c, s);
+    if(c->empty == 0){
+      c->empty = s;
+    } else {
+      kfree_order(s, c->order);
+      c->nslab--;
+    }
+  }
+}
+
+// Allocate an object from c. Returns 0 if out of memory.
+// The object's contents are whatever they were when freed.
+void*
+slaballoc(struct slabcache *c)
+{
+  void *obj;
+  int id;
+
+  push_off();
+  id = cpuid();
+  if(c->cpu[id].n == 0){
+    acquire(&c->lock);
+    while(c->cpu[id].n < SLABBATCH && (obj = slabget(c)) != 0)
+      c->cpu[id].obj[c->cpu[id].n++] = obj;
+    release(&c->lock);
+  }
+  obj = 0;
+  if(c->cpu[id].n > 0)
+    obj = c->cpu[id].obj[--c->cpu[id].n];
+  pop_off();
+  return obj;
+}
+
+// Free an object allocated from c.
+void
+slabfree(struct slabcache *c, void *obj)
+{
+  int id;
+
+  push_off();
+  id = cpuid();
+  if(c->cpu[id].n == SLABCPU){
+    acquire(&c->lock);
+    while(c->cpu[id].n > SLABCPU - SLABBATCH)
+      slabput(c, c->cpu[id].obj[--c->cpu[id].n]);
+    release(&c->lock);
+  }
+  c->cpu[id].obj[c->cpu[id].n++] = obj;
+  pop_off();
+}
@@ -0,0 +1,23 @@
+// Cache of fixed-size kernel objects, see slab.c.
+
+#define SLABCPU   16  // free objects a hart keeps
+#define SLABBATCH  8  // objects moved between a hart and the slabs at once
+
+struct slab;
+
+struct slabcache {
+  struct spinlock lock;  // protects the slabs, not the harts' objects
+  char *name;
+  int size;              // of an object, rounded up to 8 bytes
+  int order;             // a slab is 2^order pages, see kalloc_order()
+  int nperslab;          // objects in a slab
+  struct slab *partial;  // slabs with some objects free
+  struct slab *empty;    // one slab with all objects free, kept for reuse
+  uint64 nslab;          // slabs allocated
+
+  // each hart's free objects, used with interrupts off.
+  struct {
+    int n;
+    void *obj[SLABCPU];
+  } cpu[NCPU];
+};
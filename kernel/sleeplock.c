@@ -16,17 +16,26 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->hold.start = 0;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 t0 = lockprof ? clocknow() : 0;
+  int contended = 0;
+
   acquire(&lk->lk);
   while (lk->locked) {
+    contended = 1;
     sleep(lk, &lk->lk);
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  if(t0)
+    lockstart(&lk->hold, (uint64)__builtin_return_address(0), t0, contended);
+  else
+    lk->hold.start = 0;
   release(&lk->lk);
 }
 
@@ -34,6 +43,8 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  if(lk->hold.start && lockprof)
+    lockrecord(lk, lk->name, 1, &lk->hold);
   lk->locked = 0;
   lk->pid = 0;
   wakeup(lk);
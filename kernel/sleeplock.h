@@ -6,5 +6,6 @@ struct sleeplock {
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct lockhold hold; // For lockstat.c.
 };
 
@@ -8,12 +8,38 @@
 #include "proc.h"
 #include "defs.h"
 
+// Contended locks, for lockdump(). Only locks in the kernel's
+// static data are listed, since one in kalloc()ed memory, like a
+// pipe's, may be gone by the time the table is printed.
+static struct spinlock *locks[NLOCKSTAT];
+static int nlocks;
+
+extern char end[]; // first address after kernel.
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->listed = 0;
+  lk->nacquire = 0;
+  lk->ncontend = 0;
+  lk->nspin = 0;
+  lk->hold.start = 0;
+}
+
+// Put lk, found contended, in lockdump()'s table.
+static void
+locklist(struct spinlock *lk)
+{
+  int i;
+
+  if((char*)lk >= end || __sync_lock_test_and_set(&lk->listed, 1) != 0)
+    return;
+  if((i = __sync_fetch_and_add(&nlocks, 1)) < NLOCKSTAT)
+    locks[i] = lk;
 }
 
 // Acquire the lock.
@@ -21,16 +47,28 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket;
+  uint64 spin = 0, t0 = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  if(lockprof)
+    t0 = clocknow();
+
+  // On RISC-V, __sync_fetch_and_add turns into an atomic add:
   //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  //   s1 = &lk->next
+  //   amoadd.w a5, a5, (s1)
+  ticket = __sync_fetch_and_add(&lk->next, 1);
+  if(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket){
+    uint64 c0 = r_cycle();
+    locklist(lk);
+    while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+      ;
+    spin = r_cycle() - c0;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +78,15 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  lk->nacquire++;
+  if(spin){
+    lk->ncontend++;
+    lk->nspin += spin;
+  }
+  if(t0)
+    lockstart(&lk->hold, (uint64)__builtin_return_address(0), t0, spin != 0);
+  else
+    lk->hold.start = 0;
 }
 
 // Release the lock.
@@ -49,6 +96,8 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  if(lk->hold.start && lockprof)
+    lockrecord(lk, lk->name, 0, &lk->hold);
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,14 +108,9 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // Hand the lock to the next ticket. Only the holder writes
+  // owner, so a plain increment stored in one instruction will do.
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
 
   pop_off();
 }
@@ -77,7 +121,7 @@ int
 holding(struct spinlock *lk)
 {
   int r;
-  r = (lk->locked && lk->cpu == mycpu());
+  r = (lk->next != lk->owner && lk->cpu == mycpu());
   return r;
 }
 
@@ -108,3 +152,40 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Print the most contended locks, by cycles spent waiting for
+// them, on the console. Runs when user types ^L on console.
+// No lock to avoid wedging a stuck machine further; the
+// counts may be a little stale.
+#define NLOCKDUMP 10
+
+void
+lockdump(void)
+{
+  struct spinlock *top[NLOCKDUMP], *lk;
+  int i, j, n, ntop;
+
+  n = nlocks < NLOCKSTAT ? nlocks : NLOCKSTAT;
+  ntop = 0;
+  for(i = 0; i < n; i++){
+    lk = locks[i];
+    if(lk == 0)
+      continue;
+    // insert into top[], kept sorted by nspin.
+    for(j = ntop; j > 0 && top[j-1]->nspin < lk->nspin; j--)
+      if(j < NLOCKDUMP)
+        top[j] = top[j-1];
+    if(j < NLOCKDUMP){
+      top[j] = lk;
+      if(ntop < NLOCKDUMP)
+        ntop++;
+    }
+  }
+
+  printf("\n%d contended locks\n", n);
+  for(i = 0; i < ntop; i++){
+    lk = top[i];
+    printf("%s %p: %l acquired, %l contended, %l cycles waiting\n",
+           lk->name, lk, lk->nacquire, lk->ncontend, lk->nspin);
+  }
+}
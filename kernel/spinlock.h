@@ -1,9 +1,28 @@
+// The current hold of a lock, for the profile in lockstat.c.
+// Written by the holder.
+struct lockhold {
+  uint64 pc;         // Return address of the acquire.
+  uint64 start;      // clocknow() when acquired, 0 if not profiled.
+  uint64 wait;       // Time it took to acquire.
+  int contended;     // Did it have to wait?
+};
+
 // Mutual exclusion lock.
+// A ticket lock: acquire() takes the next ticket and waits until
+// owner reaches it, so waiters get the lock in arrival order.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket now holding the lock.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
-};
 
+  // Statistics for lockdump(), updated with the lock held.
+  int listed;        // In lockdump()'s table?
+  uint64 nacquire;   // Acquisitions.
+  uint64 ncontend;   // Acquisitions that had to wait.
+  uint64 nspin;      // Cycles spent waiting.
+
+  struct lockhold hold; // For lockstat.c.
+};
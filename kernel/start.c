@@ -11,9 +11,16 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][7];
 
-// assembly code in kernelvec.S for machine-mode timer interrupt.
+// each hart's timer is set for the earlier of its next periodic
+// tick and its one-shot deadline. timervec disarms it when it
+// fires, and clockfired() sets it again.
+uint64 nexttick[NCPU];  // time of the next tick, or ~0 if stopped
+uint64 oneshot[NCPU];   // time of the one-shot interrupt, or ~0
+
+// assembly code in kernelvec.S for machine-mode timer
+// and software interrupts.
 extern void timervec();
 
 // entry.S jumps here in machine mode on stack0.
@@ -43,6 +50,10 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the cycle counter, for the
+  // lock statistics in spinlock.c.
+  w_mcounteren(r_mcounteren() | 1);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -67,15 +78,21 @@ timerinit()
 
   // ask the CLINT for a timer interrupt.
   int interval = 1000000; // cycles; about 1/10th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  nexttick[id] = *(uint64*)CLINT_MTIME + interval;
+  oneshot[id] = ~0ULL;
+  *(uint64*)CLINT_MTIMECMP(id) = nexttick[id];
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[4] : desired interval (in cycles) between timer ticks.
+  // scratch[5] : set by timervec when the timer fires, see clockfired().
+  // scratch[6] : address of CLINT MSIP register, for IPIs.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
+  scratch[5] = 0;
+  scratch[6] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -84,6 +101,98 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer and software interrupts.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
+}
+
+// the rest is called in supervisor mode, through the CLINT
+// mapping in the kernel page table, with interrupts off.
+
+static void
+clockprogram(int id)
+{
+  uint64 t = nexttick[id] < oneshot[id] ? nexttick[id] : oneshot[id];
+
+  *(uint64*)CLINT_MTIMECMP(id) = t;
+}
+
+// The time, in MTIME_HZ units since boot.
+uint64
+clocknow(void)
+{
+  return *(uint64*)CLINT_MTIME;
+}
+
+// Did this hart's software interrupt come from its timer?
+// Returns 0 for an IPI, or CLOCK_TICK and/or CLOCK_ONESHOT for
+// what is due, and sets the timer for what comes next.
+int
+clockfired(void)
+{
+  int id = cpuid();
+  int r = 0;
+  uint64 now;
+
+  if(__sync_lock_test_and_set(&timer_scratch[id][5], 0) == 0)
+    return 0;
+  now = clocknow();
+  if(now >= nexttick[id]){
+    r |= CLOCK_TICK;
+    nexttick[id] += timer_scratch[id][4];
+    if(nexttick[id] <= now)
+      nexttick[id] = now + timer_scratch[id][4];
+  }
+  if(now >= oneshot[id]){
+    r |= CLOCK_ONESHOT;
+    oneshot[id] = ~0ULL;
+  }
+  clockprogram(id);
+  return r;
+}
+
+// Ask for a CLOCK_ONESHOT interrupt on this hart at time t,
+// unless one is due earlier already.
+void
+clockoneshot(uint64 t)
+{
+  int id = cpuid();
+
+  if(t < oneshot[id]){
+    oneshot[id] = t;
+    clockprogram(id);
+  }
+}
+
+// Stop this hart's ticks, for an idle hart that has nothing
+// to preempt. Returns the time, for clockrestart().
+uint64
+clockstop(void)
+{
+  int id = cpuid();
+
+  nexttick[id] = ~0ULL;
+  clockprogram(id);
+  return clocknow();
+}
+
+// Restart this hart's ticks, stopped at time t0, and return
+// the number of ticks it missed meanwhile.
+int
+clockrestart(uint64 t0)
+{
+  int id = cpuid();
+  uint64 now = clocknow();
+
+  nexttick[id] = now + timer_scratch[id][4];
+  clockprogram(id);
+  return (now - t0) / timer_scratch[id][4];
+}
+
+// Send an inter-processor interrupt to hart id. It arrives at
+// timervec, which passes it on as a supervisor software
+// interrupt like a timer tick.
+void
+ipi(int id)
+{
+  *(uint32*)CLINT_MSIP(id) = 1;
 }
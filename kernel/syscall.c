@@ -104,15 +104,19 @@ extern uint64 sys_close(void);
 extern uint64 sys_sigalarm(void);
 extern uint64 sys_sigreturn(void);
 extern uint64 sys_trace(void);
-#if defined(PBS)
 extern uint64 sys_set_priority(void);
-#endif
-
-#if defined(LBS)
 extern uint64 sys_settickets(void);
-#endif
+extern uint64 sys_setscheduler(void);
+extern uint64 sys_sched_setdeadline(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_sched_getaffinity(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_memstat(void);
 
 extern uint64 sys_waitx(void);
+extern uint64 sys_cpustat(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -142,12 +146,17 @@ static uint64 (*syscalls[])(void) = {
 [SYS_sigreturn]   = sys_sigreturn,
 [SYS_trace]   = sys_trace,
 [SYS_waitx]   = sys_waitx,
-#if defined(PBS)
+[SYS_cpustat] = sys_cpustat,
 [SYS_set_priority]   = sys_set_priority,
-#endif
-#if defined(LBS)
 [SYS_settickets]   = sys_settickets,
-#endif
+[SYS_setscheduler] = sys_setscheduler,
+[SYS_sched_setdeadline] = sys_sched_setdeadline,
+[SYS_sched_setaffinity] = sys_sched_setaffinity,
+[SYS_sched_getaffinity] = sys_sched_getaffinity,
+[SYS_clock_gettime] = sys_clock_gettime,
+[SYS_nanosleep] = sys_nanosleep,
+[SYS_lockstat] = sys_lockstat,
+[SYS_memstat] = sys_memstat,
 };
 
 static const char* sysnames[] = {
@@ -176,12 +185,17 @@ static const char* sysnames[] = {
 [SYS_sigalarm] = "sigalarm",
 [SYS_sigreturn] = "sigreturn",
 [SYS_waitx] = "waitx",
-#if defined(PBS)
+[SYS_cpustat] = "cpustat",
 [SYS_set_priority] = "set_priority",
-#endif
-#if defined(LBS)
 [SYS_settickets] = "settickets",
-#endif
+[SYS_setscheduler] = "setscheduler",
+[SYS_sched_setdeadline] = "sched_setdeadline",
+[SYS_sched_setaffinity] = "sched_setaffinity",
+[SYS_sched_getaffinity] = "sched_getaffinity",
+[SYS_clock_gettime] = "clock_gettime",
+[SYS_nanosleep] = "nanosleep",
+[SYS_lockstat] = "lockstat",
+[SYS_memstat] = "memstat",
 };
 
 static int sysargs[] = {
@@ -210,12 +224,17 @@ static int sysargs[] = {
 [SYS_sigalarm] = 2,
 [SYS_sigreturn] = 0,
 [SYS_waitx] = 3,
-#if defined(PBS)
+[SYS_cpustat] = 2,
 [SYS_set_priority] = 2,
-#endif
-#if defined(LBS)
 [SYS_settickets] = 1,
-#endif
+[SYS_setscheduler] = 2,
+[SYS_sched_setdeadline] = 3,
+[SYS_sched_setaffinity] = 2,
+[SYS_sched_getaffinity] = 1,
+[SYS_clock_gettime] = 2,
+[SYS_nanosleep] = 1,
+[SYS_lockstat] = 3,
+[SYS_memstat] = 1,
 };
 
 void
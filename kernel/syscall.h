@@ -24,9 +24,14 @@
 #define SYS_sigalarm  23
 #define SYS_sigreturn  24
 #define SYS_waitx  25
-#if defined(PBS)
 #define SYS_set_priority  26
-#endif
-#if defined(LBS)
-#define SYS_settickets  26
-#endif
+#define SYS_cpustat  27
+#define SYS_settickets  28
+#define SYS_setscheduler  29
+#define SYS_sched_setdeadline  30
+#define SYS_sched_setaffinity  31
+#define SYS_sched_getaffinity  32
+#define SYS_clock_gettime  33
+#define SYS_nanosleep  34
+#define SYS_lockstat  35
+#define SYS_memstat   36
@@ -6,6 +6,10 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "cpustat.h"
+#include "time.h"
+#include "lockstat.h"
+#include "memstat.h"
 
 uint64
 sys_exit(void)
@@ -61,17 +65,12 @@ sys_sleep(void)
   uint ticks0;
 
   argint(0, &n);
+  if(n < 0)
+    n = 0;
   acquire(&tickslock);
   ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
   release(&tickslock);
-  return 0;
+  return sleepuntil(ticks0 + n);
 }
 
 uint64
@@ -159,7 +158,6 @@ sys_trace(void)
   return 0;
 }
 
-#if defined(PBS)
 uint64
 sys_set_priority(void)
 {
@@ -170,10 +168,7 @@ sys_set_priority(void)
 
   return set_priority(np, pid);
 }
-#endif
-
 
-#if defined(LBS)
 uint64
 sys_settickets(void)
 {
@@ -185,11 +180,96 @@ sys_settickets(void)
     return -1;
   }
   acquire(&p->lock);
-  p->tickets = n;
+  runqsettickets(p, n);
   release(&p->lock);
   return 0;
 }
-#endif
+
+uint64
+sys_sched_setdeadline(void)
+{
+  int runtime, period, deadline, r;
+  struct proc *p = myproc();
+
+  argint(0, &runtime);
+  argint(1, &period);
+  argint(2, &deadline);
+  acquire(&p->lock);
+  r = runqsetdeadline(p, runtime, period, deadline);
+  release(&p->lock);
+  return r;
+}
+
+uint64
+sys_clock_gettime(void)
+{
+  int clk;
+  uint64 addr, now;
+  struct timespec ts;
+
+  argint(0, &clk);
+  argaddr(1, &addr);
+  if(clk != CLOCK_MONOTONIC)
+    return -1;
+  now = clocknow();
+  ts.tv_sec = now / MTIME_HZ;
+  ts.tv_nsec = (now % MTIME_HZ) * (1000000000 / MTIME_HZ);
+  if(copyout(myproc()->pagetable, addr, (char*)&ts, sizeof(ts)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64
+sys_nanosleep(void)
+{
+  uint64 addr, n, now;
+  struct timespec ts;
+
+  argaddr(0, &addr);
+  if(copyin(myproc()->pagetable, (char*)&ts, addr, sizeof(ts)) < 0)
+    return -1;
+  if(ts.tv_nsec >= 1000000000)
+    return -1;
+  now = clocknow();
+  // a sleep too long to fit in mtime lasts until killed.
+  if(ts.tv_sec > (~0ULL - now) / MTIME_HZ)
+    return hrsleepuntil(~0ULL);
+  // round up to whole mtime units.
+  n = ts.tv_sec * MTIME_HZ +
+      (ts.tv_nsec + 1000000000 / MTIME_HZ - 1) / (1000000000 / MTIME_HZ);
+  if(n > ~0ULL - now)
+    n = ~0ULL - now;
+  return hrsleepuntil(now + n);
+}
+
+uint64
+sys_sched_setaffinity(void)
+{
+  int pid, mask;
+
+  argint(0, &pid);
+  argint(1, &mask);
+  return sched_setaffinity(pid, mask);
+}
+
+uint64
+sys_sched_getaffinity(void)
+{
+  int pid;
+
+  argint(0, &pid);
+  return sched_getaffinity(pid);
+}
+
+uint64
+sys_setscheduler(void)
+{
+  int pid, policy;
+
+  argint(0, &pid);
+  argint(1, &policy);
+  return setscheduler(pid, policy);
+}
 
 uint64
 sys_waitx(void)
@@ -207,3 +287,78 @@ sys_waitx(void)
     return -1;
   return ret;
 }
+
+// copy the statistics of up to n started harts to the
+// struct cpustat array at addr. returns the number copied.
+uint64
+sys_cpustat(void)
+{
+  uint64 addr;
+  int n, i;
+  struct cpu *c;
+  struct cpustat cs;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  i = 0;
+  for(c = cpus; c < &cpus[NCPU] && i < n; c++){
+    if(!c->started)
+      continue;
+    cs.cpu = c - cpus;
+    cs.nrunnable = c->rq.nrunnable;
+    cs.busy = c->busy;
+    cs.idle = c->idle;
+    cs.nswitch = c->nswitch;
+    cs.nsteal = c->nsteal;
+    cs.nmigrate = c->nmigrate;
+    cs.npreempt = c->npreempt;
+    cs.npghit = c->npghit;
+    cs.npgrefill = c->npgrefill;
+    cs.npgdrain = c->npgdrain;
+    cs.npgsteal = c->npgsteal;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(cs), (char*)&cs, sizeof(cs)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// start (LOCKSTAT_ON) or stop (LOCKSTAT_OFF) the lock profiler,
+// or copy up to n of its records to the struct lockstat array
+// at addr (LOCKSTAT_READ), returning the number copied, or
+// return the number of samples dropped (LOCKSTAT_DROPPED).
+uint64
+sys_lockstat(void)
+{
+  int cmd, n;
+  uint64 addr;
+
+  argint(0, &cmd);
+  argaddr(1, &addr);
+  argint(2, &n);
+  switch(cmd){
+  case LOCKSTAT_ON:
+  case LOCKSTAT_OFF:
+    lockstatctl(cmd == LOCKSTAT_ON);
+    return 0;
+  case LOCKSTAT_READ:
+    return lockstatread(addr, n);
+  case LOCKSTAT_DROPPED:
+    return lockstatdropped();
+  }
+  return -1;
+}
+
+// copy the free memory statistics to the struct memstat at addr.
+uint64
+sys_memstat(void)
+{
+  uint64 addr;
+  struct memstat ms;
+
+  argaddr(0, &addr);
+  kmemstat(&ms);
+  if(copyout(myproc()->pagetable, addr, (char*)&ms, sizeof(ms)) < 0)
+    return -1;
+  return 0;
+}
@@ -0,0 +1,173 @@
+// Timed sleeps.
+//
+// A process that sleeps until a tick puts a timer on a wheel of
+// NTSLOT lists, hashed by the tick it expires at, and sleeps on
+// the timer. On every tick clockintr() calls timertick(), which
+// only looks at the list of the current tick and wakes the
+// processes whose timers have expired; a timer more than NTSLOT
+// ticks away stays on its list for further turns of the wheel.
+// tickslock protects the wheel.
+//
+// Sleeps shorter than a tick, or that must end between ticks,
+// use a list of high resolution timers sorted by the mtime they
+// expire at instead, and a one-shot timer interrupt. A hart that
+// puts a timer at the head of the list asks for a one-shot
+// interrupt at its time, and a hart whose one-shot fires wakes
+// the expired sleepers and asks for one at the new head's time,
+// so some hart always has one due no later than the head.
+// hrlock protects the list.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NTSLOT 64
+
+struct timer {
+  uint64 expires;         // tick or mtime to wake up at
+  int pending;            // on its list?
+  struct timer *next;
+  struct timer *prev;
+};
+
+static struct timer *wheel[NTSLOT];
+
+static struct spinlock hrlock;
+static struct timer *hrlist;
+
+void
+timerinit(void)
+{
+  initlock(&hrlock, "hrtimer");
+}
+
+// Has tick t been reached? Correct across wrap-around of ticks.
+static int
+expired(uint t)
+{
+  return (int)(ticks - t) >= 0;
+}
+
+// Link t into the list at *head after prev, or first if prev is 0.
+static void
+timeradd(struct timer **head, struct timer *prev, struct timer *t, uint64 expires)
+{
+  t->expires = expires;
+  t->pending = 1;
+  t->prev = prev;
+  t->next = prev ? prev->next : *head;
+  if(t->next)
+    t->next->prev = t;
+  if(prev)
+    prev->next = t;
+  else
+    *head = t;
+}
+
+static void
+timerdel(struct timer **head, struct timer *t)
+{
+  if(!t->pending)
+    return;
+  if(t->prev)
+    t->prev->next = t->next;
+  else
+    *head = t->next;
+  if(t->next)
+    t->next->prev = t->prev;
+  t->pending = 0;
+}
+
+// Wake the sleepers whose timers expire at this tick.
+// Called by clockintr() with tickslock held.
+void
+timertick(void)
+{
+  struct timer **slot = &wheel[ticks % NTSLOT];
+  struct timer *t, *next;
+
+  for(t = *slot; t; t = next){
+    next = t->next;
+    if(expired(t->expires)){
+      timerdel(slot, t);
+      wakeup(t);
+    }
+  }
+}
+
+// Sleep until tick expires. Returns -1 if the process was
+// killed before then, 0 otherwise.
+int
+sleepuntil(uint expires)
+{
+  struct timer **slot = &wheel[expires % NTSLOT];
+  struct timer t;
+
+  t.pending = 0;
+  acquire(&tickslock);
+  while(!expired(expires)){
+    if(killed(myproc())){
+      timerdel(slot, &t);
+      release(&tickslock);
+      return -1;
+    }
+    if(!t.pending)
+      timeradd(slot, 0, &t, expires);
+    sleep(&t, &tickslock);
+  }
+  timerdel(slot, &t);
+  release(&tickslock);
+  return 0;
+}
+
+// Wake the sleepers whose high resolution timers have expired.
+// Called by devintr() when this hart's one-shot interrupt fires.
+void
+hrtimertick(void)
+{
+  struct timer *t;
+  uint64 now = clocknow();
+
+  acquire(&hrlock);
+  while((t = hrlist) != 0 && t->expires <= now){
+    timerdel(&hrlist, t);
+    wakeup(t);
+  }
+  if(hrlist)
+    clockoneshot(hrlist->expires);
+  release(&hrlock);
+}
+
+// Sleep until clocknow() reaches expires. Returns -1 if the
+// process was killed before then, 0 otherwise.
+int
+hrsleepuntil(uint64 expires)
+{
+  struct timer t, *prev;
+
+  t.pending = 0;
+  acquire(&hrlock);
+  while(clocknow() < expires){
+    if(killed(myproc())){
+      timerdel(&hrlist, &t);
+      release(&hrlock);
+      return -1;
+    }
+    if(!t.pending){
+      prev = 0;
+      for(struct timer *q = hrlist; q && q->expires <= expires; q = q->next)
+        prev = q;
+      timeradd(&hrlist, prev, &t, expires);
+      if(hrlist == &t)
+        clockoneshot(expires);
+    }
+    sleep(&t, &hrlock);
+  }
+  timerdel(&hrlist, &t);
+  release(&hrlock);
+  return 0;
+}
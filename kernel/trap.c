@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "vdso.h"
 #include "defs.h"
 
 struct spinlock tickslock;
@@ -45,6 +46,9 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // coming from user space, this hart was in no rcu read section.
+  mycpu()->nqs++;
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -133,7 +137,8 @@ usertrap(void)
   if(killed(p))
     exit(-1);
 
-#if defined(FCFS) || defined(PBS)
+  // give up the CPU if this is a timer interrupt and
+  // p's scheduling class wants to preempt it.
   if(which_dev == 2){
     p->ticksp++;
     if(p->ticksn > 0 && p->ticksp - p->tickspa == p->ticksn && p->sigalarm)
@@ -142,37 +147,18 @@ usertrap(void)
       *(p->trapcopy) = *(p->trapframe);
       p->trapframe->epc = p->handler;
     }
+    if(runqtick(p) && !dlthrottle(p))
+      yield();
   }
-#else
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2){
-    p->ticksp++;
-    if(p->ticksn > 0 && p->ticksp - p->tickspa == p->ticksn && p->sigalarm)
-    {
-      p->sigalarm = 0;
-      *(p->trapcopy) = *(p->trapframe);
-      p->trapframe->epc = p->handler;
-    }
-#if defined(MLFQ)
-    p->ticksused++;
-    if(p->ticksused >= (1 << p->queue)) yield();
-    else {
-      struct proc* tp;
-      for(tp = proc; tp < &proc[NPROC]; tp++) {
-        acquire(&tp->lock);
-        if(tp->state == RUNNABLE && tp->queue < p->queue) {
-          release(&tp->lock);
-          yield();
-          break;
-        }
-        release(&tp->lock);
-      }
-    }
-#else
+
+  // or if a process that should run before p was queued on
+  // this hart and sent it a reschedule IPI.
+  if(which_dev != 0 && runqpreempted())
     yield();
-#endif
-  }
-#endif
+
+  // an EDF process that used its runtime in the kernel.
+  if(p->dlthrottled)
+    dlthrottle(p);
 
   usertrapret();
 }
@@ -229,9 +215,7 @@ void
 kerneltrap()
 {
   int which_dev = 0;
-#if !defined(FCFS) && !defined(PBS)
   uint64 sepc = r_sepc();
-#endif
   uint64 sstatus = r_sstatus();
   uint64 scause = r_scause();
   
@@ -246,37 +230,22 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-#if defined(FCFS) || defined(PBS)
-  // dont give up CPU in non-premptive scheduling
-#else
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING) {
-#if defined(MLFQ)
-    struct proc* p = myproc();
-    p->ticksused++;
-    if(p->ticksused >= (1 << p->queue)) yield();
-    else {
-      struct proc* tp;
-      for(tp = proc; tp < &proc[NPROC]; tp++) {
-        acquire(&tp->lock);
-        if(tp->state == RUNNABLE && tp->queue < p->queue) {
-          release(&tp->lock);
-          yield();
-          break;
-        }
-        release(&tp->lock);
-      }
-    }
-#else
+  // give up the CPU if this is a timer interrupt and
+  // the process's scheduling class wants to preempt it; an EDF
+  // process that used its runtime in the kernel is throttled
+  // when it returns to user space.
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING &&
+     runqtick(myproc())){
+    dlthrottlelater(myproc());
+    yield();
+  } else if(which_dev != 0 && myproc() != 0 && myproc()->state == RUNNING &&
+          runqpreempted())
     yield();
-#endif
-  }
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
   w_sstatus(sstatus);
-#endif
 }
 
 void
@@ -284,28 +253,14 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
-  struct proc* p;
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == RUNNABLE) {
-#if defined(MLFQ)
-      p->waittime++;
-      if(p->waittime >= MAX_WAIT_TIME) {
-        p->waittime = 0;
-#if defined(TRACE_QUEUE)
-        printf("[%d] queue for %d changed from %d to %d\n", ticks, p->pid, p->queue, p->queue - 1 < 0 ? 0 : p->queue - 1);
-#endif
-        p->queue--;
-        if(p->queue < 0) p->queue = 0;
-      }
-#endif
-    } else if (p->state == RUNNING) {
-      p->rtime++;
-    }
-    release(&p->lock);
-  }
-  wakeup(&ticks);
+  ukdata->ticks = ticks;
+  timertick();
   release(&tickslock);
+
+  rcupoll();
+
+  if(ticks % BALANCE_TICKS == 0)
+    runqbalance();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -317,6 +272,8 @@ int
 devintr()
 {
   uint64 scause = r_scause();
+  struct proc *p;
+  int r;
 
   if((scause & 0x8000000000000000L) &&
      (scause & 0xff) == 9){
@@ -341,17 +298,35 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // an IPI wakes an idle hart from wfi, or makes the
+    // trap handler look at runqpreempted().
+    if((r = clockfired()) == 0)
+      return 1;
+    if(r & CLOCK_ONESHOT)
+      hrtimertick();
+    if((r & CLOCK_TICK) == 0)
+      return 1;
+
+    if(cpuid() == 0){
+      clockintr();
+    }
+
+    // every hart charges the tick to the process it is running.
+    // only this hart writes p->rtime while p runs here.
+    if((p = mycpu()->proc) != 0){
+      p->rtime++;
+      mycpu()->busy++;
+    } else {
+      mycpu()->idle++;
+    }
+
     return 2;
   } else {
     return 0;
@@ -0,0 +1,14 @@
+// Pages the kernel maps read-only into every process, so that
+// user code can read these without a system call; see ulib.c.
+
+// At USYSCALL, one page per process.
+struct usyscall {
+  int pid;
+  int cpu;          // hart the process runs on, set by scheduler()
+};
+
+// At UKDATA, one page shared by all processes.
+struct ukdata {
+  uint ticks;       // copy of ticks, updated by clockintr()
+  uint64 clockhz;   // rate of the mtime counter at UMTIME_MTIME
+};
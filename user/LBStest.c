@@ -2,20 +2,23 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/riscv.h"
+#include "kernel/sched.h"
 #include "user/user.h"
 
 int
 main(int argc, char *argv[])
 {
-#if !defined(LBS)
-  printf("kernel not compiled with LBS\n");
-  exit(1);
-#else
+  if(argc != 3){
+    fprintf(2, "Usage: LBStest <tickets1> <tickets2>\n");
+    exit(1);
+  }
   int t1 = atoi(argv[1]);
   int t2 = atoi(argv[2]);
   if(t1 < 0 || t2 < 0){
     exit(1);
   }
+  // the child inherits the policy.
+  setscheduler(getpid(), SCHED_LBS);
   int f = fork();
   if(f == 0)
   {
@@ -44,5 +47,4 @@ main(int argc, char *argv[])
   }
   write(2, "\n", 1);
   return 0;
-#endif
 }
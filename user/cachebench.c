@@ -0,0 +1,67 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/cpustat.h"
+#include "user/user.h"
+
+// Runs CPU-bound children that each sweep their own working
+// set, first free to run on any hart and then each pinned to
+// one, and reports the time taken and how often children
+// changed harts, e.g. "cachebench 8 64".
+
+#define NCHILD  8
+#define WSKB    64      // working set of each child, in KB
+#define NSWEEP  400
+
+static void
+run(int n, int wskb, int pin, int ncpu)
+{
+  struct cpustat before[NCPU], after[NCPU];
+  int i, start, moves;
+
+  cpustat(before, NCPU);
+  start = uptime();
+  for(i = 0; i < n; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "cachebench: fork failed\n");
+      break;
+    }
+    if(pid == 0){
+      int len = wskb * 1024;
+      char *ws;
+      if(pin)
+        sched_setaffinity(getpid(), 1 << (i % ncpu));
+      if((ws = malloc(len)) == 0)
+        exit(1);
+      for(int s = 0; s < NSWEEP; s++)
+        for(int j = 0; j < len; j += 64)
+          ws[j] += s;
+      exit(0);
+    }
+  }
+  for(; i > 0; i--)
+    wait(0);
+  cpustat(after, NCPU);
+
+  moves = 0;
+  for(i = 0; i < ncpu; i++)
+    moves += (after[i].nsteal - before[i].nsteal) +
+             (after[i].nmigrate - before[i].nmigrate);
+  printf("%s: %d ticks, %d steals and migrations\n",
+         pin ? "pinned  " : "unpinned", uptime() - start, moves);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct cpustat cs[NCPU];
+  int n, wskb, ncpu;
+
+  n = argc > 1 ? atoi(argv[1]) : NCHILD;
+  wskb = argc > 2 ? atoi(argv[2]) : WSKB;
+  ncpu = cpustat(cs, NCPU);
+  printf("%d children, %dKB each, on %d harts\n", n, wskb, ncpu);
+  run(n, wskb, 0, ncpu);
+  run(n, wskb, 1, ncpu);
+  exit(0);
+}
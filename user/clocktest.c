@@ -0,0 +1,55 @@
+#include "kernel/types.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+// Measures the cost and resolution of clock_gettime() and how
+// long nanosleep() actually sleeps for a range of requests.
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64 reqs[] = { 50000, 1000000, 10000000, 150000000 };
+
+int
+main(int argc, char *argv[])
+{
+  struct timespec ts;
+  uint64 t0, t1, min;
+  int i;
+
+  t0 = nsnow();
+  for(i = 0; i < 100000; i++)
+    nsnow();
+  t1 = nsnow();
+  printf("clock_gettime cost: %l ns\n", (t1 - t0) / 100000);
+
+  // smallest non-zero step between two readings.
+  min = ~0ULL;
+  for(i = 0; i < 1000; i++){
+    t0 = nsnow();
+    while((t1 = nsnow()) == t0)
+      ;
+    if(t1 - t0 < min)
+      min = t1 - t0;
+  }
+  printf("clock_gettime resolution: %l ns\n", min);
+
+  for(i = 0; i < sizeof(reqs) / sizeof(reqs[0]); i++){
+    ts.tv_sec = reqs[i] / 1000000000;
+    ts.tv_nsec = reqs[i] % 1000000000;
+    t0 = nsnow();
+    if(nanosleep(&ts) < 0){
+      fprintf(2, "clocktest: nanosleep failed\n");
+      exit(1);
+    }
+    t1 = nsnow();
+    printf("nanosleep %l us: slept %l us\n", reqs[i] / 1000, (t1 - t0) / 1000);
+  }
+  exit(0);
+}
@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// Runs a periodic job, a tick's worth of work every PERIOD
+// ticks, against CPU-bound noise, first under the default
+// scheduler and then as an EDF process, and counts the jobs
+// that missed their deadline, e.g. "edftest 8 50".
+
+#define RUNTIME  3
+#define PERIOD   10
+#define NNOISE   8
+#define NJOBS    50
+
+static volatile int sink;
+
+// Iterations of the job loop that take about a tick on an
+// idle machine.
+static int
+calibrate(void)
+{
+  int n, t;
+
+  t = uptime();
+  while(uptime() == t)
+    ;
+  t = uptime();
+  for(n = 0; uptime() == t; n++)
+    sink++;
+  return n;
+}
+
+static int
+run(int njobs, int work)
+{
+  int i, j, start, release, missed;
+
+  missed = 0;
+  start = uptime();
+  for(i = 0; i < njobs; i++){
+    release = start + i * PERIOD;
+    if(uptime() < release)
+      sleep(release - uptime());
+    for(j = 0; j < work; j++)
+      sink++;
+    if(uptime() > release + PERIOD)
+      missed++;
+  }
+  return missed;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nnoise, njobs, work, i, missed;
+  int pids[64];
+
+  nnoise = argc > 1 ? atoi(argv[1]) : NNOISE;
+  njobs = argc > 2 ? atoi(argv[2]) : NJOBS;
+  if(nnoise > 64)
+    nnoise = 64;
+  work = calibrate();
+
+  for(i = 0; i < nnoise; i++){
+    if((pids[i] = fork()) < 0){
+      fprintf(2, "edftest: fork failed\n");
+      nnoise = i;
+      break;
+    }
+    if(pids[i] == 0){
+      for(;;)
+        sink++;
+    }
+  }
+
+  missed = run(njobs, work);
+  printf("default: %d of %d jobs missed their deadline\n", missed, njobs);
+
+  if(sched_setdeadline(RUNTIME, PERIOD, PERIOD) < 0){
+    fprintf(2, "edftest: sched_setdeadline not admitted\n");
+  } else {
+    missed = run(njobs, work);
+    printf("EDF: %d of %d jobs missed their deadline\n", missed, njobs);
+  }
+
+  for(i = 0; i < nnoise; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}
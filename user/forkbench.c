@@ -0,0 +1,87 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/cpustat.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+// Runs 1, 2, 4 and 8 processes that each fork and exec a child
+// over and over, and prints the fork+execs per second for each,
+// and how the harts' page magazines served the kalloc()s, to
+// show how the page allocator scales with CPUS, e.g.
+// "forkbench 200".
+
+#define NITER 100
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+storm(int n)
+{
+  char *argv[] = { "forkbench", "-", 0 };
+  int i, pid;
+
+  for(i = 0; i < n; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "forkbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[0], argv);
+      fprintf(2, "forkbench: exec failed\n");
+      exit(1);
+    }
+    wait(0);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct cpustat before[NCPU], after[NCPU];
+  int n, nproc, ncpu, i;
+  uint64 start, elapsed, hit, refill, steal;
+
+  // the child exec'd by storm().
+  if(argc > 1 && strcmp(argv[1], "-") == 0)
+    exit(0);
+
+  n = argc > 1 ? atoi(argv[1]) : NITER;
+  for(nproc = 1; nproc <= 8; nproc *= 2){
+    ncpu = cpustat(before, NCPU);
+    start = nsnow();
+    for(i = 0; i < nproc; i++){
+      int pid = fork();
+      if(pid < 0){
+        fprintf(2, "forkbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        storm(n);
+        exit(0);
+      }
+    }
+    for(i = 0; i < nproc; i++)
+      wait(0);
+    elapsed = nsnow() - start;
+    cpustat(after, NCPU);
+
+    hit = refill = steal = 0;
+    for(i = 0; i < ncpu; i++){
+      hit += after[i].npghit - before[i].npghit;
+      refill += after[i].npgrefill - before[i].npgrefill;
+      steal += after[i].npgsteal - before[i].npgsteal;
+    }
+    printf("%d processes: %l fork+execs per s, %l hits %l refills %l steals\n",
+           nproc, (uint64)n * nproc * 1000000000 / (elapsed ? elapsed : 1),
+           hit, refill, steal);
+  }
+  exit(0);
+}
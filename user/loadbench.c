@@ -0,0 +1,52 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/cpustat.h"
+#include "user/user.h"
+
+// Runs CPU-bound children on all harts and reports how busy
+// each hart was while they ran, e.g. "make qemu CPUS=8" then
+// "loadbench 16".
+
+#define NCHILD 16
+
+int
+main(int argc, char *argv[])
+{
+  struct cpustat before[NCPU], after[NCPU];
+  int n, i, ncpu, start, elapsed;
+
+  n = argc > 1 ? atoi(argv[1]) : NCHILD;
+  ncpu = cpustat(before, NCPU);
+  start = uptime();
+
+  for(i = 0; i < n; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "loadbench: fork failed\n");
+      break;
+    }
+    if(pid == 0){
+      for(volatile long long j = 0; j < 1000000000; j++)
+        ;
+      exit(0);
+    }
+  }
+  for(; i > 0; i--)
+    wait(0);
+
+  elapsed = uptime() - start;
+  cpustat(after, NCPU);
+
+  printf("%d children on %d harts in %d ticks\n", n, ncpu, elapsed);
+  for(i = 0; i < ncpu; i++){
+    uint64 busy = after[i].busy - before[i].busy;
+    uint64 idle = after[i].idle - before[i].idle;
+    uint64 total = busy + idle;
+    printf("hart %d: %d%% busy, %d switches, %d steals, %d migrations\n",
+           after[i].cpu, total ? (int)(busy * 100 / total) : 0,
+           (int)(after[i].nswitch - before[i].nswitch),
+           (int)(after[i].nsteal - before[i].nsteal),
+           (int)(after[i].nmigrate - before[i].nmigrate));
+  }
+  exit(0);
+}
@@ -0,0 +1,154 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+// Profiles the kernel's locks while a command runs, then prints
+// the locks, and the places they were acquired from, that were
+// waited for longest, e.g. "lockstat pipebench" or
+// "lockstat -n 20 usertests -q".
+
+#define NREC (NCPU * NLSREC)
+#define NTOP 10
+#define NHIST 3  // how many of the top records get histograms
+
+static struct lockstat *recs;
+static int nrecs;
+
+static uint64
+us(uint64 t)
+{
+  return t * 1000000 / MTIME_HZ;
+}
+
+// Add the records of each (lock name, pc) to the first one of
+// them, and zero the rest's nacquire.
+static void
+merge(struct lockstat *m, int n)
+{
+  int i, j, b;
+
+  for(i = 0; i < n; i++){
+    if(m[i].nacquire == 0)
+      continue;
+    for(j = i + 1; j < n; j++){
+      if(m[j].nacquire == 0 || m[j].pc != m[i].pc || strcmp(m[j].name, m[i].name) != 0)
+        continue;
+      m[i].nacquire += m[j].nacquire;
+      m[i].ncontend += m[j].ncontend;
+      m[i].wait += m[j].wait;
+      m[i].hold += m[j].hold;
+      for(b = 0; b < NLSBUCKET; b++){
+        m[i].waithist[b] += m[j].waithist[b];
+        m[i].holdhist[b] += m[j].holdhist[b];
+      }
+      m[j].nacquire = 0;
+    }
+  }
+}
+
+static void
+hist(char *what, uint64 *h)
+{
+  int b;
+
+  printf("    %s:", what);
+  for(b = 0; b < NLSBUCKET; b++)
+    if(h[b])
+      printf(" <%lns:%l", ((uint64)1 << b) * 1000000000 / MTIME_HZ, h[b]);
+  printf("\n");
+}
+
+// Print how the wait for ls was split between harts, from
+// the unmerged records.
+static void
+perhart(struct lockstat *ls)
+{
+  int i;
+
+  printf("    wait by hart:");
+  for(i = 0; i < nrecs; i++)
+    if(recs[i].pc == ls->pc && strcmp(recs[i].name, ls->name) == 0)
+      printf(" %d:%lus", recs[i].cpu, us(recs[i].wait));
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat *m, *top[NTOP];
+  int ntop, i, j, k, pid, ndropped;
+
+  ntop = NTOP;
+  i = 1;
+  if(argc > 2 && strcmp(argv[1], "-n") == 0){
+    ntop = atoi(argv[2]);
+    if(ntop > NTOP)
+      ntop = NTOP;
+    i = 3;
+  }
+  if(i >= argc){
+    fprintf(2, "usage: lockstat [-n top] command [args]\n");
+    exit(1);
+  }
+
+  recs = malloc(2 * NREC * sizeof(struct lockstat));
+  if(recs == 0){
+    fprintf(2, "lockstat: out of memory\n");
+    exit(1);
+  }
+  m = recs + NREC;
+
+  lockstat(LOCKSTAT_ON, 0, 0);
+  if((pid = fork()) < 0){
+    fprintf(2, "lockstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[i], &argv[i]);
+    fprintf(2, "lockstat: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+  wait(0);
+  lockstat(LOCKSTAT_OFF, 0, 0);
+  ndropped = lockstat(LOCKSTAT_DROPPED, 0, 0);
+
+  if((nrecs = lockstat(LOCKSTAT_READ, recs, NREC)) < 0){
+    fprintf(2, "lockstat: lockstat failed\n");
+    exit(1);
+  }
+  memmove(m, recs, nrecs * sizeof(struct lockstat));
+  merge(m, nrecs);
+
+  // the ntop records with the most total wait, in order.
+  k = 0;
+  for(i = 0; i < nrecs; i++){
+    if(m[i].nacquire == 0)
+      continue;
+    for(j = k; j > 0 && top[j-1]->wait < m[i].wait; j--)
+      if(j < ntop)
+        top[j] = top[j-1];
+    if(j < ntop){
+      top[j] = &m[i];
+      if(k < ntop)
+        k++;
+    }
+  }
+
+  printf("lock\tpc\tacquired\tcontended\twait us\thold us\n");
+  for(i = 0; i < k; i++){
+    printf("%s%s\t%p\t%l\t%l\t%l\t%l\n", top[i]->name,
+           top[i]->sleep ? " (sleep)" : "", top[i]->pc,
+           top[i]->nacquire, top[i]->ncontend,
+           us(top[i]->wait), us(top[i]->hold));
+    if(i < NHIST){
+      perhart(top[i]);
+      hist("wait", top[i]->waithist);
+      hist("hold", top[i]->holdhist);
+    }
+  }
+  if(ndropped > 0)
+    printf("%d samples dropped, the harts' tables were full\n", ndropped);
+  exit(0);
+}
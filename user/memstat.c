@@ -0,0 +1,39 @@
+#include "kernel/types.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Prints the free blocks of each order in the kernel's buddy
+// allocator and, for each order, the share of free memory that
+// is in smaller blocks and so could not serve a block of that
+// order: 0% when memory is unfragmented, near 100% when it is
+// all in small pieces. Also prints how well the pool of pages
+// zeroed by idle harts keeps up.
+
+int
+main(void)
+{
+  struct memstat ms;
+  uint64 free, below;
+  int i;
+
+  if(memstat(&ms) < 0){
+    fprintf(2, "memstat: failed\n");
+    exit(1);
+  }
+  free = 0;
+  for(i = 0; i < NORDER; i++)
+    free += ms.nfree[i] << i;
+
+  printf("order  pages   free  unusable\n");
+  below = 0;
+  for(i = 0; i < NORDER; i++){
+    printf("%d\t%d\t%l\t%l%%\n", i, 1 << i, ms.nfree[i],
+           free ? below * 100 / free : 0);
+    below += ms.nfree[i] << i;
+  }
+  printf("%l free pages, %l more in magazines\n", free, ms.nmag);
+  printf("%l splits, %l merges\n", ms.nsplit, ms.nmerge);
+  printf("%l zeroed pages, %l zeroed allocations from the pool, %l not\n",
+         ms.nzero, ms.nzhit, ms.nzmiss);
+  exit(0);
+}
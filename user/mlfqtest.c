@@ -2,15 +2,14 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/riscv.h"
+#include "kernel/sched.h"
 #include "user/user.h"
 
 int
 main(int argc, char *argv[])
 {
-#if !defined(MLFQ)
-  printf("kernel not compiled with MLFQ\n");
-  exit(1);
-#else
+  // the child inherits the policy.
+  setscheduler(getpid(), SCHED_MLFQ);
   int f = fork();
   if(f == 0)
   {
@@ -40,5 +39,4 @@ main(int argc, char *argv[])
   }
   write(1, "\n", 1);
   return 0;
-#endif
 }
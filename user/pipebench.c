@@ -0,0 +1,86 @@
+#include "kernel/types.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+// Bounces a byte between two processes over a pair of pipes
+// while other processes sleep on pipes of their own, and
+// reports the time a round trip takes, e.g. "pipebench 20000 32".
+
+#define NROUND  20000
+#define NIDLE   32
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, nidle, i;
+  uint64 start, elapsed;
+  int ping[2], pong[2], idle[2];
+  char c = 0;
+
+  n = argc > 1 ? atoi(argv[1]) : NROUND;
+  nidle = argc > 2 ? atoi(argv[2]) : NIDLE;
+
+  // sleepers blocked in read() until the end.
+  if(pipe(idle) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nidle; i++){
+    int pid = fork();
+    if(pid < 0){
+      nidle = i;
+      break;
+    }
+    if(pid == 0){
+      close(idle[1]);
+      read(idle[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(idle[0]);
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    fprintf(2, "pipebench: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    close(idle[1]);
+    for(i = 0; i < n; i++){
+      if(read(ping[0], &c, 1) != 1)
+        exit(1);
+      write(pong[1], &c, 1);
+    }
+    exit(0);
+  }
+
+  start = nsnow();
+  for(i = 0; i < n; i++){
+    write(ping[1], &c, 1);
+    if(read(pong[0], &c, 1) != 1){
+      fprintf(2, "pipebench: read failed\n");
+      break;
+    }
+  }
+  elapsed = nsnow() - start;
+  wait(0);
+
+  // wake the sleepers.
+  close(idle[1]);
+  for(; nidle > 0; nidle--)
+    wait(0);
+
+  printf("%d round trips in %l us", i, elapsed / 1000);
+  if(i > 0)
+    printf(", %l ns each", elapsed / i);
+  printf("\n");
+  exit(0);
+}
@@ -24,9 +24,7 @@ int main() {
           printf("Process %d finished\n", n);
           exit(0);
       } else {
-#ifdef PBS
         set_priority(60-IO+n, pid); // Will only matter for PBS, set lower priority for IO bound processes 
-#endif
       }
   }
   for(;n > 0; n--) {
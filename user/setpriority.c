@@ -7,7 +7,6 @@ main(int argc, char* argv[])
     fprintf(2, "Usage: setpriority <new_priority> <pid>\n");
     exit(1);
   }
-#if defined(PBS)
   int np = atoi(argv[1]);
   int pid = atoi(argv[2]);
   if(set_priority(np, pid) < 0) {
@@ -15,8 +14,4 @@ main(int argc, char* argv[])
     exit(1);
   }
   exit(0);
-#else
-  fprintf(2, "kernel not compiled with Priority Based Scheduling\n");
-  exit(1);
-#endif
 }
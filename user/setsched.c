@@ -0,0 +1,47 @@
+#include "kernel/types.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// setsched                 print the system's policy
+// setsched <policy>        switch the system and every process
+// setsched <policy> <pid>  switch only process pid
+
+static char *names[NSCHED] = {
+[SCHED_RR]   = "RR",
+[SCHED_FCFS] = "FCFS",
+[SCHED_PBS]  = "PBS",
+[SCHED_LBS]  = "LBS",
+[SCHED_MLFQ] = "MLFQ",
+[SCHED_CFS]  = "CFS",
+[SCHED_EDF]  = "EDF",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int policy, pid, old;
+
+  if(argc < 2){
+    printf("%s\n", names[setscheduler(0, -1)]);
+    exit(0);
+  }
+  for(policy = 0; policy < NSCHED; policy++)
+    if(strcmp(argv[1], names[policy]) == 0)
+      break;
+  if(policy == NSCHED || argc > 3){
+    fprintf(2, "Usage: setsched [RR|FCFS|PBS|LBS|MLFQ|CFS [pid]]\n");
+    exit(1);
+  }
+  // EDF needs a runtime and period, names[] has it only to print.
+  if(policy == SCHED_EDF){
+    fprintf(2, "setsched: EDF is set with sched_setdeadline, see edftest\n");
+    exit(1);
+  }
+  pid = argc == 3 ? atoi(argv[2]) : 0;
+  if((old = setscheduler(pid, policy)) < 0){
+    fprintf(2, "setsched: cannot switch %d to %s\n", pid, argv[1]);
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[policy]);
+  exit(0);
+}
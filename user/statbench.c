@@ -0,0 +1,70 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+// Runs 1, 2, 4 and 8 processes that each stat() and open() the
+// same files over and over, and prints the lookups per ms for
+// each, to show how lookups in the inode and file tables scale
+// across harts, e.g. "statbench 2000".
+
+#define NITER 1000
+
+static char *files[] = { "README.md", "cat", "." };
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+lookups(int n)
+{
+  struct stat st;
+  int i, fd;
+  char *f;
+
+  for(i = 0; i < n; i++){
+    f = files[i % (sizeof(files) / sizeof(files[0]))];
+    if(stat(f, &st) < 0 || (fd = open(f, O_RDONLY)) < 0){
+      fprintf(2, "statbench: %s failed\n", f);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, nproc, i;
+  uint64 start, elapsed;
+
+  n = argc > 1 ? atoi(argv[1]) : NITER;
+  for(nproc = 1; nproc <= 8; nproc *= 2){
+    start = nsnow();
+    for(i = 0; i < nproc; i++){
+      int pid = fork();
+      if(pid < 0){
+        fprintf(2, "statbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        lookups(n);
+        exit(0);
+      }
+    }
+    for(i = 0; i < nproc; i++)
+      wait(0);
+    elapsed = nsnow() - start;
+    // each iteration looks its file up twice.
+    printf("%d processes: %l lookups per ms\n", nproc,
+           (uint64)2 * n * nproc * 1000000 / (elapsed ? elapsed : 1));
+  }
+  exit(0);
+}
@@ -0,0 +1,78 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// taskset <mask> <command> [args...]  run command on the harts in mask
+// taskset -p <pid>                    print the mask of process pid
+// taskset -p <mask> <pid>             set the mask of process pid
+//
+// Masks are in hex, bit i for hart i, e.g. "taskset 3 loadbench".
+
+static int
+hex(char *s)
+{
+  int n, d;
+
+  if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    s += 2;
+  if(*s == 0)
+    return -1;
+  for(n = 0; *s; s++){
+    if('0' <= *s && *s <= '9')
+      d = *s - '0';
+    else if('a' <= *s && *s <= 'f')
+      d = *s - 'a' + 10;
+    else if('A' <= *s && *s <= 'F')
+      d = *s - 'A' + 10;
+    else
+      return -1;
+    n = n*16 + d;
+  }
+  return n;
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "Usage: taskset <mask> <command> [args...]\n");
+  fprintf(2, "       taskset -p [<mask>] <pid>\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mask, pid;
+
+  if(argc < 3)
+    usage();
+
+  if(strcmp(argv[1], "-p") == 0){
+    if(argc == 3){
+      pid = atoi(argv[2]);
+      if((mask = sched_getaffinity(pid)) < 0){
+        fprintf(2, "taskset: no process %d\n", pid);
+        exit(1);
+      }
+      printf("pid %d's affinity mask: %x\n", pid, mask);
+      exit(0);
+    }
+    if(argc != 4 || (mask = hex(argv[2])) < 0)
+      usage();
+    pid = atoi(argv[3]);
+    if(sched_setaffinity(pid, mask) < 0){
+      fprintf(2, "taskset: cannot set affinity of %d to %x\n", pid, mask);
+      exit(1);
+    }
+    exit(0);
+  }
+
+  if((mask = hex(argv[1])) < 0)
+    usage();
+  if(sched_setaffinity(getpid(), mask) < 0){
+    fprintf(2, "taskset: no started hart in %x\n", mask);
+    exit(1);
+  }
+  exec(argv[2], &argv[2]);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
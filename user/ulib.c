@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/time.h"
+#include "kernel/vdso.h"
 #include "user/user.h"
 
 //
@@ -145,3 +149,38 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// The kernel maps read-only pages with these at USYSCALL,
+// UKDATA and UMTIME (see kernel/vdso.h), so reading them
+// needs no system call.
+
+int
+getpid(void)
+{
+  return ((struct usyscall*)USYSCALL)->pid;
+}
+
+int
+getcpu(void)
+{
+  return ((volatile struct usyscall*)USYSCALL)->cpu;
+}
+
+int
+uptime(void)
+{
+  return ((volatile struct ukdata*)UKDATA)->ticks;
+}
+
+int
+clock_gettime(int clockid, struct timespec *ts)
+{
+  uint64 hz = ((struct ukdata*)UKDATA)->clockhz;
+  uint64 now = *(volatile uint64*)UMTIME_MTIME;
+
+  if(clockid != CLOCK_MONOTONIC)
+    return -1;
+  ts->tv_sec = now / hz;
+  ts->tv_nsec = (now % hz) * (1000000000 / hz);
+  return 0;
+}
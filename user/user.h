@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 
 struct stat;
+struct cpustat;
+struct timespec;
+struct lockstat;
+struct memstat;
 
 // system calls
 int fork(void);
@@ -20,22 +24,23 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
 int sigalarm(int, void (*handler)(void));
 int sigreturn(void);
 int trace(int mask);
 
-#if defined(PBS)
 int set_priority(int new_priority, int pid);
-#endif
-
-#if defined(LBS)
 int settickets(int);
-#endif
+int setscheduler(int pid, int policy);
+int sched_setdeadline(int runtime, int period, int deadline);
+int sched_setaffinity(int pid, int mask);
+int sched_getaffinity(int pid);
+int nanosleep(struct timespec *req);
+int lockstat(int cmd, struct lockstat*, int);
+int memstat(struct memstat*);
 int waitx(int *, int *, int *);
+int cpustat(struct cpustat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -53,3 +58,7 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int getpid(void);
+int getcpu(void);
+int uptime(void);
+int clock_gettime(int clockid, struct timespec *ts);
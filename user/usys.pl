@@ -32,11 +32,19 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
 entry("sigalarm");
 entry("sigreturn");
 entry("trace");
 entry("waitx");
+entry("cpustat");
+entry("set_priority");
+entry("settickets");
+entry("setscheduler");
+entry("sched_setdeadline");
+entry("sched_setaffinity");
+entry("sched_getaffinity");
+entry("nanosleep");
+entry("lockstat");
+entry("memstat");
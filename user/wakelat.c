@@ -0,0 +1,97 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/cpustat.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+// Measures how long a process woken by a pipe write waits to
+// run while CPU-bound processes keep every hart busy, and how
+// many preemptions reschedule IPIs caused meanwhile, e.g.
+// "wakelat 50 4" for 50 wakeups against 4 spinners.
+
+#define NWAKE 50
+#define NSPIN 4
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct cpustat before[NCPU], after[NCPU];
+  int n, nspin, i, ncpu, fds[2], spin[NPROC], reader;
+  uint64 t0, lat, sum, max, npreempt;
+
+  n = argc > 1 ? atoi(argv[1]) : NWAKE;
+  nspin = argc > 2 ? atoi(argv[2]) : NSPIN;
+  if(nspin > NPROC / 2)
+    nspin = NPROC / 2;
+  if(pipe(fds) < 0){
+    fprintf(2, "wakelat: pipe failed\n");
+    exit(1);
+  }
+
+  for(i = 0; i < nspin; i++){
+    if((spin[i] = fork()) < 0){
+      fprintf(2, "wakelat: fork failed\n");
+      break;
+    }
+    if(spin[i] == 0){
+      for(;;)
+        ;
+    }
+    // under PBS, the spinners come after the reader.
+    set_priority(90, spin[i]);
+  }
+  nspin = i;
+
+  ncpu = cpustat(before, NCPU);
+  reader = fork();
+  if(reader < 0){
+    fprintf(2, "wakelat: fork failed\n");
+    exit(1);
+  }
+  if(reader == 0){
+    close(fds[1]);
+    sum = max = 0;
+    for(i = 0; i < n && read(fds[0], &t0, sizeof(t0)) == sizeof(t0); i++){
+      lat = nsnow() - t0;
+      sum += lat;
+      if(lat > max)
+        max = lat;
+    }
+    if(i > 0)
+      printf("%d wakeups: %l us on average, %l us at most\n",
+             i, sum / i / 1000, max / 1000);
+    exit(0);
+  }
+  set_priority(10, reader);
+
+  close(fds[0]);
+  for(i = 0; i < n; i++){
+    // let the reader go back to sleep.
+    sleep(1);
+    t0 = nsnow();
+    write(fds[1], &t0, sizeof(t0));
+  }
+  close(fds[1]);
+  wait(0);
+
+  cpustat(after, NCPU);
+  npreempt = 0;
+  for(i = 0; i < ncpu; i++)
+    npreempt += after[i].npreempt - before[i].npreempt;
+  printf("%l preemptions by reschedule IPIs\n", npreempt);
+
+  for(i = 0; i < nspin; i++)
+    kill(spin[i]);
+  for(i = 0; i < nspin; i++)
+    wait(0);
+  exit(0);
+}